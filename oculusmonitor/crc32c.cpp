@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#include "crc32c.h"
+#include <cstring>
+
+// LibOVR.lib doesn't include the CRC32_Table_CRC32_C that OVR_CRC32.h declares, so the tables are made here.
+// Without SSE4.2 the table path reads 8 bytes a step (slicing by 8), a few times slower than the instruction.
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define CRC32C_HARDWARE
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CRC32C_TARGET
+#else
+#include <cpuid.h>
+#define CRC32C_TARGET __attribute__((target("sse4.2")))
+#endif
+#endif
+
+namespace
+{
+	const unsigned int c_polynomial = 0x82f63b78;	// 0x1EDC6F41 bit reversed
+
+	struct Tables
+	{
+		unsigned int table[8][256];
+
+		Tables()
+		{
+			for (unsigned int i = 0; i < 256; ++i)
+			{
+				unsigned int crc = i;
+				for (int bit = 0; bit < 8; ++bit)
+				{
+					crc = (crc >> 1) ^ (crc & 1 ? c_polynomial : 0);
+				}
+				table[0][i] = crc;
+			}
+			for (unsigned int i = 0; i < 256; ++i)
+			{
+				for (int t = 1; t < 8; ++t)
+				{
+					table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xff];
+				}
+			}
+		}
+	};
+
+	unsigned int crcTables(const unsigned char *data, size_t size, unsigned int crc)
+	{
+		static const Tables s_tables;
+		const unsigned int (*t)[256] = s_tables.table;
+		for (; size >= 8; data += 8, size -= 8)
+		{
+			unsigned int low, high;
+			memcpy(&low, data, 4);
+			memcpy(&high, data + 4, 4);
+			low ^= crc;
+			crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^
+				t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^ t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+		}
+		for (; size; ++data, --size)
+		{
+			crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xff];
+		}
+		return crc;
+	}
+
+#ifdef CRC32C_HARDWARE
+	bool hasSSE42()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 1);
+		return (info[2] & (1 << 20)) != 0;
+#else
+		unsigned int a, b, c, d;
+		return __get_cpuid(1, &a, &b, &c, &d) && (c & bit_SSE4_2) != 0;
+#endif
+	}
+
+	CRC32C_TARGET unsigned int crcHardware(const unsigned char *data, size_t size, unsigned int crc)
+	{
+		for (; size && ((size_t)data & 7); ++data, --size)
+		{
+			crc = _mm_crc32_u8(crc, *data);
+		}
+		unsigned long long crc64 = crc;
+		for (; size >= 8; data += 8, size -= 8)
+		{
+			unsigned long long value;
+			memcpy(&value, data, 8);
+			crc64 = _mm_crc32_u64(crc64, value);
+		}
+		crc = (unsigned int)crc64;
+		for (; size; ++data, --size)
+		{
+			crc = _mm_crc32_u8(crc, *data);
+		}
+		return crc;
+	}
+#endif
+}
+
+unsigned int crc32c(const void *data, size_t size, unsigned int crc)
+{
+#ifdef CRC32C_HARDWARE
+	static const bool s_hardware = hasSSE42();
+	if (s_hardware)
+	{
+		return ~crcHardware((const unsigned char *)data, size, ~crc);
+	}
+#endif
+	return ~crcTables((const unsigned char *)data, size, ~crc);
+}
@@ -0,0 +1,15 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#pragma once
+#include <cstddef>
+
+// CRC32-C (Castagnoli, polynomial 0x1EDC6F41), the checksum of the SDK's OVR_CRC32.h. Uses the SSE4.2 crc32
+// instruction when the CPU has it, otherwise tables, with the same result either way.
+// Pass a previous result as crc to carry on over more data.
+unsigned int crc32c(const void *data, size_t size, unsigned int crc = 0);
@@ -0,0 +1,54 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#pragma once
+#include "vrstate.h"
+#include "latency.h"
+
+// Where the sampler gets its data from. The live source wraps LibOVR, the others let the
+// capture/record/export pipeline run without a headset or the Oculus runtime.
+// All methods are called from the sampler thread only.
+class DeviceSource
+{
+public:
+	DeviceSource() : m_latency(0)
+	{
+	}
+
+	virtual ~DeviceSource()
+	{
+	}
+
+	// Where to time SDK calls. Set by the sampler before begin(), may be null.
+	void setLatency(LatencyStats *latency)
+	{
+		m_latency = latency;
+	}
+
+	// Called on the sampler thread before the first sample.
+	virtual void begin()
+	{
+	}
+
+	// Fill in the next sample, including time and runtimeTime. Returns false when the source has run out.
+	virtual bool sample(VRState &state) = 0;
+
+	// Update any slowly changing device data in info. Returns true if anything changed.
+	// now is seconds since the sampler started.
+	virtual bool pollDeviceInfo(DeviceInfo &info, double now) = 0;
+
+	// True if the sampler should pace calls to sample() at its rate. Sources that are
+	// self-timed, or that should run as fast as possible, return false.
+	virtual bool paced() const
+	{
+		return true;
+	}
+
+protected:
+	LatencyStats *m_latency;
+};
@@ -0,0 +1,117 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#include "flightrecorder.h"
+#include <cmath>
+
+namespace
+{
+	const unsigned int c_triggerButtons = ovrButton_LThumb | ovrButton_RThumb;
+
+	// Drop runs that ended before the oldest kept sample. The run holding it stays, its start is clamped on snapshot.
+	template<typename T>
+	void trimRuns(std::vector<T> &runs, unsigned long long first)
+	{
+		size_t keep = 0;
+		while (keep + 1 < runs.size() && runs[keep + 1].start <= first)
+		{
+			keep++;
+		}
+		if (keep)
+		{
+			runs.erase(runs.begin(), runs.begin() + keep);
+		}
+	}
+}
+
+FlightRecorder::FlightRecorder() : m_last(), m_trigger(false), m_triggerHeld(false)
+{
+}
+
+void FlightRecorder::setDuration(double seconds, double sampleRate)
+{
+	// One extra block since the newest is only partly filled.
+	unsigned int blocks = (unsigned int)std::ceil(seconds * sampleRate / SampleStore::c_blockSamples) + 1;
+	m_samples.setCapacity(blocks);
+	clear();
+}
+
+void FlightRecorder::clear()
+{
+	m_samples.clear();
+	m_rateSegments.clear();
+	m_epochs.clear();
+}
+
+void FlightRecorder::add(const VRState &state, const std::shared_ptr<const DeviceInfo> &info)
+{
+	bool held = (state.touchButtons & c_triggerButtons) == c_triggerButtons;
+	if (held && !m_triggerHeld)
+	{
+		m_trigger = true;
+	}
+	m_triggerHeld = held;
+
+	if (!m_samples.empty() && StateManager::isRepeat(m_last, state))
+	{
+		return;
+	}
+	m_last = state;
+	m_last.time = state.runtimeTime;
+
+	unsigned int index = (unsigned int)(m_samples.discarded() + m_samples.size());
+	if (m_rateSegments.empty() || m_rateSegments.back().rate != state.sampleRate)
+	{
+		RateSegment segment = { index, state.sampleRate };
+		m_rateSegments.push_back(segment);
+	}
+	if (info && (m_epochs.empty() || m_epochs.back().info != info))
+	{
+		DeviceEpoch epoch = { index, info };
+		m_epochs.push_back(epoch);
+	}
+	m_samples.push_back(m_last);
+
+	trimRuns(m_rateSegments, m_samples.discarded());
+	trimRuns(m_epochs, m_samples.discarded());
+}
+
+void FlightRecorder::snapshot(StateManager &target) const
+{
+	target.reset();
+	target.m_samples = m_samples;
+	unsigned int first = (unsigned int)m_samples.discarded();
+	for (size_t i = 0; i < m_rateSegments.size(); ++i)
+	{
+		RateSegment segment = m_rateSegments[i];
+		segment.start = segment.start > first ? segment.start - first : 0;
+		target.m_rateSegments.push_back(segment);
+	}
+	for (size_t i = 0; i < m_epochs.size(); ++i)
+	{
+		DeviceEpoch epoch = m_epochs[i];
+		epoch.start = epoch.start > first ? epoch.start - first : 0;
+		target.m_epochs.push_back(epoch);
+	}
+}
+
+bool FlightRecorder::triggered()
+{
+	bool trigger = m_trigger;
+	m_trigger = false;
+	return trigger;
+}
+
+double FlightRecorder::length() const
+{
+	if (m_samples.size() < 2)
+	{
+		return 0;
+	}
+	return m_samples.time(m_samples.size() - 1) - m_samples.time(0);
+}
@@ -0,0 +1,38 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#pragma once
+#include "vrstate.h"
+
+// Keeps the last few seconds of samples in a fixed amount of memory, so a tracking problem can be saved after it
+// happened. Runs alongside live view and recording, fed by StateManager::poll().
+class FlightRecorder
+{
+public:
+	FlightRecorder();
+
+	// Keep at least this many seconds at the given sample rate (longer if samples are skipped as repeats or the
+	// rate drops). Clears what has been captured so far.
+	void setDuration(double seconds, double sampleRate);
+	void clear();
+	void add(const VRState &state, const std::shared_ptr<const DeviceInfo> &info);
+	// Replace the manager's recording with a copy of what has been captured. Sampling carries on.
+	void snapshot(StateManager &target) const;
+	// True once each time both thumbsticks are clicked together.
+	bool triggered();
+	// Seconds currently held.
+	double length() const;
+
+	SampleStore m_samples;
+	// Starts count from the first sample added since clear(), including any since dropped (see SampleStore::discarded()).
+	std::vector<RateSegment> m_rateSegments;
+	std::vector<DeviceEpoch> m_epochs;
+	VRState m_last;
+	bool m_trigger;
+	bool m_triggerHeld;
+};
@@ -0,0 +1,155 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#pragma once
+#include <cmath>
+
+// Tracks how far the real interval between samples strays from the sampler's target interval,
+// on the sampler's wall clock and on the runtime clock, over the last c_window samples.
+// Fixed size, updating never allocates.
+class JitterMonitor
+{
+public:
+	enum
+	{
+		c_window = 2048,		// Samples in the rolling statistics, histogram and time series
+		c_bins = 64				// Histogram bins, spanning -1 to +1 target intervals of error
+	};
+
+	float m_error[c_window];		// Wall interval minus target interval (us), ring buffer
+	float m_clockDelta[c_window];	// Runtime interval minus wall interval (us), ring buffer
+	float m_histogram[c_bins];		// Count of m_error values per bin (float so it can be plotted directly)
+	unsigned char m_bin[c_window];	// Histogram bin of each m_error value, the target can change while it is in the window
+	unsigned int m_next;			// Next slot in the ring buffers
+	unsigned int m_filled;			// Valid entries in the ring buffers
+	double m_errorSum;
+	double m_errorSquares;
+	double m_target;				// Latest target interval (s)
+	double m_lastWall;
+	double m_lastRuntime;
+	double m_maxLateness;			// us, since reset
+	unsigned long long m_samples;
+	unsigned long long m_late;		// Samples taken more than half an interval after they were due
+
+	JitterMonitor()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		for (int i = 0; i < c_window; ++i)
+		{
+			m_error[i] = 0;
+			m_clockDelta[i] = 0;
+			m_bin[i] = 0;
+		}
+		for (int i = 0; i < c_bins; ++i)
+		{
+			m_histogram[i] = 0;
+		}
+		m_next = 0;
+		m_filled = 0;
+		m_errorSum = 0;
+		m_errorSquares = 0;
+		m_target = 0;
+		m_lastWall = -1;
+		m_lastRuntime = 0;
+		m_maxLateness = 0;
+		m_samples = 0;
+		m_late = 0;
+	}
+
+	// wallTime and runtimeTime in seconds, lateness in microseconds.
+	void update(double wallTime, double runtimeTime, float sampleRate, float lateness)
+	{
+		double wallInterval = wallTime - m_lastWall;
+		bool paired = m_lastWall >= 0 && wallInterval > 0 && sampleRate > 0;
+		m_lastWall = wallTime;
+		double runtimeInterval = runtimeTime - m_lastRuntime;
+		m_lastRuntime = runtimeTime;
+		if (!paired)
+		{
+			// First sample, or the sampler was restarted.
+			return;
+		}
+
+		m_target = 1.0 / sampleRate;
+		m_samples++;
+		if (lateness > m_maxLateness)
+		{
+			m_maxLateness = lateness;
+		}
+		if (lateness > m_target * 0.5e6)
+		{
+			m_late++;
+		}
+
+		float error = (float)((wallInterval - m_target) * 1e6);
+		if (m_filled == c_window)
+		{
+			// Drop the oldest value from the rolling statistics.
+			float old = m_error[m_next];
+			m_errorSum -= old;
+			m_errorSquares -= (double)old * old;
+			m_histogram[m_bin[m_next]] -= 1.0f;
+		}
+		else
+		{
+			m_filled++;
+		}
+		m_error[m_next] = error;
+		m_clockDelta[m_next] = (float)((runtimeInterval - wallInterval) * 1e6);
+		m_bin[m_next] = (unsigned char)bin(error);
+		m_errorSum += error;
+		m_errorSquares += (double)error * error;
+		m_histogram[m_bin[m_next]] += 1.0f;
+		m_next = (m_next + 1) % c_window;
+		if (m_next == 0)
+		{
+			// Resum once per lap so rounding in the running sums can't build up over a long session.
+			m_errorSum = 0;
+			m_errorSquares = 0;
+			for (int i = 0; i < c_window; ++i)
+			{
+				m_errorSum += m_error[i];
+				m_errorSquares += (double)m_error[i] * m_error[i];
+			}
+		}
+	}
+
+	// Mean of wall interval minus target (us). Positive means running slow.
+	double meanError() const
+	{
+		return m_filled > 0 ? m_errorSum / m_filled : 0.0;
+	}
+
+	// Standard deviation of the interval (us), the jitter.
+	double jitter() const
+	{
+		if (m_filled < 2)
+			return 0.0;
+		double mean = meanError();
+		double variance = m_errorSquares / m_filled - mean * mean;
+		return variance > 0 ? sqrt(variance) : 0.0;
+	}
+
+	// Offset to pass to plotting functions so the ring buffers are drawn oldest first.
+	unsigned int plotOffset() const
+	{
+		return m_filled == c_window ? m_next : 0;
+	}
+
+protected:
+	int bin(float error) const
+	{
+		double target = m_target > 0 ? m_target * 1e6 : 1.0;
+		int index = (int)floor((error / target + 1.0) * 0.5 * c_bins);
+		return index < 0 ? 0 : (index >= c_bins ? c_bins - 1 : index);
+	}
+};
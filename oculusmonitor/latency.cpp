@@ -0,0 +1,171 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#include "latency.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+const char *g_latencyCallNames[e_latencyCount] = { "ovr_GetTimeInSeconds", "ovr_GetTrackingState", "ovr_GetInputState (Remote)", "ovr_GetInputState (Touch)", "ovr_GetDevicePoses", "ovr_GetTrackerPose", "ovr_GetTrackerCount/Desc", "ovr_GetConnectedControllerTypes", "ovr_GetHmdDesc", "ovr_GetBoundaryGeometry", "Sample total", "Poll total" };
+const char *g_latencyColumnNames[e_latencyCount] = { "GetTimeLatency", "TrackingStateLatency", "RemoteInputLatency", "TouchInputLatency", "DevicePosesLatency", "TrackerPoseLatency", "TrackersLatency", "ControllersLatency", "HmdDescLatency", "BoundaryLatency", "SampleLatency", "PollLatency" };
+
+namespace
+{
+	unsigned int highestBit(unsigned long long value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return index;
+#else
+		return 63 - __builtin_clzll(value);
+#endif
+	}
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+	reset();
+}
+
+unsigned int LatencyHistogram::bucket(unsigned long long ns)
+{
+	// Values below 16 get a bucket each, above that 16 buckets per power of two.
+	if (ns < c_subBuckets)
+	{
+		return (unsigned int)ns;
+	}
+	unsigned int exponent = highestBit(ns);
+	unsigned int sub = (unsigned int)(ns >> (exponent - 4)) & (c_subBuckets - 1);
+	unsigned int index = (exponent - 3) * c_subBuckets + sub;
+	return index < c_bucketCount ? index : c_bucketCount - 1;
+}
+
+unsigned long long LatencyHistogram::bucketLimit(unsigned int index)
+{
+	// Largest value that lands in the bucket.
+	if (index < c_subBuckets)
+	{
+		return index;
+	}
+	unsigned int exponent = index / c_subBuckets + 3;
+	unsigned long long sub = index % c_subBuckets;
+	return ((c_subBuckets + sub + 1) << (exponent - 4)) - 1;
+}
+
+void LatencyHistogram::record(unsigned long long ns)
+{
+	// Single writer, so plain loads and stores are enough (no locked read-modify-write).
+	std::atomic<unsigned int> &counter = m_counts[bucket(ns)];
+	counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	m_total.store(m_total.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+	if (ns > m_max.load(std::memory_order_relaxed))
+	{
+		m_max.store(ns, std::memory_order_relaxed);
+	}
+}
+
+void LatencyHistogram::reset()
+{
+	for (int i = 0; i < c_bucketCount; ++i)
+	{
+		m_counts[i].store(0, std::memory_order_relaxed);
+	}
+	m_count = 0;
+	m_total = 0;
+	m_max = 0;
+}
+
+unsigned long long LatencyHistogram::count() const
+{
+	return m_count.load(std::memory_order_relaxed);
+}
+
+unsigned long long LatencyHistogram::max() const
+{
+	return m_max.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const
+{
+	unsigned long long count = m_count.load(std::memory_order_relaxed);
+	return count > 0 ? (double)m_total.load(std::memory_order_relaxed) / count : 0.0;
+}
+
+unsigned long long LatencyHistogram::percentile(double fraction) const
+{
+	// Count from the buckets themselves, the totals may be a sample ahead or behind while the writer is active.
+	unsigned long long total = 0;
+	for (int i = 0; i < c_bucketCount; ++i)
+	{
+		total += m_counts[i].load(std::memory_order_relaxed);
+	}
+	if (total == 0)
+	{
+		return 0;
+	}
+	unsigned long long target = (unsigned long long)(fraction * total + 0.5);
+	if (target < 1)
+	{
+		target = 1;
+	}
+	unsigned long long seen = 0;
+	for (int i = 0; i < c_bucketCount; ++i)
+	{
+		seen += m_counts[i].load(std::memory_order_relaxed);
+		if (seen >= target)
+		{
+			unsigned long long limit = bucketLimit(i);
+			unsigned long long maximum = max();
+			return limit < maximum ? limit : maximum;
+		}
+	}
+	return max();
+}
+
+LatencyStats::LatencyStats() : m_current(), m_resetRequested(false)
+{
+}
+
+void LatencyStats::record(LatencyCall call, std::chrono::steady_clock::duration duration)
+{
+	unsigned long long ns = (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+	m_histograms[call].record(ns);
+	m_current[call] += ns * 0.001f;
+}
+
+void LatencyStats::beginSample()
+{
+	if (m_resetRequested.exchange(false))
+	{
+		for (int i = 0; i < e_latencyCount; ++i)
+		{
+			m_histograms[i].reset();
+		}
+	}
+	for (int i = 0; i < e_latencyCount; ++i)
+	{
+		m_current[i] = 0;
+	}
+}
+
+const float *LatencyStats::current() const
+{
+	return m_current;
+}
+
+void LatencyStats::requestReset()
+{
+	m_resetRequested = true;
+}
+
+const LatencyHistogram &LatencyStats::histogram(LatencyCall call) const
+{
+	return m_histograms[call];
+}
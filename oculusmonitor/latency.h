@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#pragma once
+#include <atomic>
+#include <chrono>
+
+// Timed calls on the sampling path.
+enum LatencyCall
+{
+	e_latencyGetTime,
+	e_latencyTrackingState,
+	e_latencyRemoteInput,
+	e_latencyTouchInput,
+	e_latencyDevicePoses,
+	e_latencyTrackerPoses,
+	e_latencyTrackers,
+	e_latencyControllers,
+	e_latencyHmd,
+	e_latencyBoundary,
+	e_latencySample,		// All of DeviceSource::sample()
+	e_latencyPoll,			// One sampler iteration, everything but the sleep
+	e_latencyCount
+};
+
+extern const char *g_latencyCallNames[e_latencyCount];
+extern const char *g_latencyColumnNames[e_latencyCount];
+
+// Log-linear histogram of durations in nanoseconds. Each power of two is split into 16 linear buckets,
+// so any value is within 1/16 (6%) of its bucket. Fixed size, recording never allocates.
+// One thread may record while others read. Readers see a slightly stale but usable snapshot.
+class LatencyHistogram
+{
+public:
+	enum
+	{
+		c_subBuckets = 16,
+		c_bucketCount = c_subBuckets * 34	// Up to 2^37ns, about two minutes
+	};
+
+	LatencyHistogram();
+
+	// Writer thread only.
+	void record(unsigned long long ns);
+	void reset();
+
+	unsigned long long count() const;
+	unsigned long long max() const;
+	double mean() const;
+	// Upper bound of the bucket holding the given fraction (0 to 1) of values, in ns.
+	unsigned long long percentile(double fraction) const;
+
+	static unsigned int bucket(unsigned long long ns);
+	static unsigned long long bucketLimit(unsigned int index);
+
+protected:
+	std::atomic<unsigned int> m_counts[c_bucketCount];
+	std::atomic<unsigned long long> m_count;
+	std::atomic<unsigned long long> m_total;
+	std::atomic<unsigned long long> m_max;
+};
+
+// Histograms for every timed call, plus the durations of the calls made for the current sample.
+class LatencyStats
+{
+public:
+	LatencyStats();
+
+	// Writer thread only.
+	void record(LatencyCall call, std::chrono::steady_clock::duration duration);
+	// Start a new sample, clearing the per sample durations. Also carries out any requested reset.
+	void beginSample();
+	// Microseconds spent in each call since beginSample(), 0 for calls that weren't made.
+	const float *current() const;
+
+	// Any thread. The histograms are cleared by the writer at the start of the next sample.
+	void requestReset();
+
+	const LatencyHistogram &histogram(LatencyCall call) const;
+
+protected:
+	LatencyHistogram m_histograms[e_latencyCount];
+	float m_current[e_latencyCount];
+	std::atomic<bool> m_resetRequested;
+};
+
+// Times its own lifetime into a LatencyStats. Does nothing if stats is null.
+class LatencyTimer
+{
+public:
+	LatencyTimer(LatencyStats *stats, LatencyCall call) : m_stats(stats), m_call(call)
+	{
+		if (m_stats)
+		{
+			m_start = std::chrono::steady_clock::now();
+		}
+	}
+
+	~LatencyTimer()
+	{
+		if (m_stats)
+		{
+			m_stats->record(m_call, std::chrono::steady_clock::now() - m_start);
+		}
+	}
+
+protected:
+	LatencyStats *m_stats;
+	LatencyCall m_call;
+	std::chrono::steady_clock::time_point m_start;
+};
@@ -0,0 +1,197 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#include "livesource.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	bool samePoints(const std::vector<ovrVector3f> &a, const std::vector<ovrVector3f> &b)
+	{
+		return a.size() == b.size() && (a.empty() || memcmp(&a[0], &b[0], a.size() * sizeof(ovrVector3f)) == 0);
+	}
+
+	void getBoundary(ovrSession hmd, ovrBoundaryType type, std::vector<ovrVector3f> &points)
+	{
+		int count = 0;
+		ovr_GetBoundaryGeometry(hmd, type, 0, &count);
+		points.resize(count);
+		if (count > 0)
+		{
+			ovr_GetBoundaryGeometry(hmd, type, &points[0], &count);
+		}
+	}
+}
+
+LiveSource::LiveSource(ovrSession hmd) : m_hmd(hmd), m_schedule(e_pollTaskCount), m_connectedControllers(0), m_sensorCount(0), m_sensorPose()
+{
+	m_schedule.setRate(e_pollTrackerPoses, 10.0);
+	m_schedule.setRate(e_pollTrackers, 1.0);
+	m_schedule.setRate(e_pollControllers, 4.0);
+	m_schedule.setRate(e_pollHmd, 0.5);
+	m_schedule.setRate(e_pollBoundary, 1.0);
+}
+
+void LiveSource::begin()
+{
+	for (int i = 0; i < e_pollTaskCount; ++i)
+	{
+		m_schedule.trigger(i);
+	}
+}
+
+void LiveSource::setPollRate(PollTask task, double rateHz)
+{
+	m_schedule.setRate(task, rateHz);
+}
+
+bool LiveSource::sample(VRState &state)
+{
+	{
+		LatencyTimer timer(m_latency, e_latencyGetTime);
+		state.runtimeTime = ovr_GetTimeInSeconds();
+	}
+	state.time = state.runtimeTime;
+	{
+		LatencyTimer timer(m_latency, e_latencyTrackingState);
+		state.trackingState = ovr_GetTrackingState(m_hmd, 0, false);
+	}
+	ovrInputState temp;
+	{
+		LatencyTimer timer(m_latency, e_latencyRemoteInput);
+		ovr_GetInputState(m_hmd, ovrControllerType::ovrControllerType_Remote, &temp);
+	}
+	state.remoteButtons = temp.Buttons;
+	{
+		LatencyTimer timer(m_latency, e_latencyTouchInput);
+		ovr_GetInputState(m_hmd, ovrControllerType::ovrControllerType_Touch, &temp);
+	}
+	state.touchButtons = temp.Buttons;
+	state.touchTouch = temp.Touches;
+	for (int i = 0; i < 2; ++i)
+	{
+		state.touchHandTrigger[i] = temp.HandTrigger[i];
+		state.touchHandTriggerNDZ[i] = temp.HandTriggerNoDeadzone[i];
+		state.touchHandTriggerRaw[i] = temp.HandTriggerRaw[i];
+		state.touchIndexTrigger[i] = temp.IndexTrigger[i];
+		state.touchIndexTriggerNDZ[i] = temp.IndexTriggerNoDeadzone[i];
+		state.touchIndexTriggerRaw[i] = temp.IndexTriggerRaw[i];
+		state.touchThumbStick[i] = temp.Thumbstick[i];
+		state.touchThumbStickNDZ[i] = temp.ThumbstickNoDeadzone[i];
+		state.touchThumbStickRaw[i] = temp.ThumbstickRaw[i];
+	}
+
+	// All tracked objects in one batched call. Head and hands come from ovr_GetTrackingState above,
+	// since that is also the only source of their status flags and the calibrated origin.
+	state.objectFlags = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		if (m_connectedControllers & (ovrControllerType_Object0 << i))
+		{
+			state.objectFlags |= 1 << i;
+		}
+	}
+	if (state.objectFlags)
+	{
+		ovrTrackedDeviceType types[4] = { ovrTrackedDevice_Object0, ovrTrackedDevice_Object1, ovrTrackedDevice_Object2, ovrTrackedDevice_Object3 };
+		ovrResult result;
+		{
+			LatencyTimer timer(m_latency, e_latencyDevicePoses);
+			result = ovr_GetDevicePoses(m_hmd, types, 4, 0, state.objectPoses);
+		}
+		if (OVR_FAILURE(result))
+		{
+			state.objectFlags = 0;
+		}
+	}
+	if (!state.objectFlags)
+	{
+		memset(state.objectPoses, 0, sizeof(state.objectPoses));
+	}
+
+	state.sensorCount = m_sensorCount;
+	memcpy(state.sensorPose, m_sensorPose, sizeof(state.sensorPose));
+	return true;
+}
+
+bool LiveSource::pollDeviceInfo(DeviceInfo &info, double now)
+{
+	bool changed = false;
+	if (m_schedule.due(e_pollTrackers, now))
+	{
+		LatencyTimer timer(m_latency, e_latencyTrackers);
+		unsigned int count = std::min(ovr_GetTrackerCount(m_hmd), 4u);
+		ovrTrackerDesc desc[4] = {};
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			desc[i] = ovr_GetTrackerDesc(m_hmd, i);
+		}
+		if (count != info.sensorCount || memcmp(desc, info.sensorDesc, sizeof(desc)) != 0)
+		{
+			info.sensorCount = count;
+			memcpy(info.sensorDesc, desc, sizeof(desc));
+			m_sensorCount = count;
+			m_schedule.trigger(e_pollTrackerPoses);
+			changed = true;
+		}
+	}
+	if (m_schedule.due(e_pollTrackerPoses, now))
+	{
+		LatencyTimer timer(m_latency, e_latencyTrackerPoses);
+		for (unsigned int i = 0; i < m_sensorCount; ++i)
+		{
+			m_sensorPose[i] = ovr_GetTrackerPose(m_hmd, i);
+		}
+	}
+	if (m_schedule.due(e_pollControllers, now))
+	{
+		{
+			LatencyTimer timer(m_latency, e_latencyControllers);
+			m_connectedControllers = ovr_GetConnectedControllerTypes(m_hmd);
+		}
+		if (m_connectedControllers != info.connectedControllers)
+		{
+			info.connectedControllers = m_connectedControllers;
+			changed = true;
+		}
+	}
+	if (m_schedule.due(e_pollHmd, now))
+	{
+		ovrHmdDesc hmdDesc;
+		ovrTrackingOrigin trackingOrigin;
+		{
+			LatencyTimer timer(m_latency, e_latencyHmd);
+			hmdDesc = ovr_GetHmdDesc(m_hmd);
+			trackingOrigin = ovr_GetTrackingOriginType(m_hmd);
+		}
+		if (memcmp(&hmdDesc, &info.hmdDesc, sizeof(ovrHmdDesc)) != 0 || trackingOrigin != info.trackingOrigin)
+		{
+			info.hmdDesc = hmdDesc;
+			info.trackingOrigin = trackingOrigin;
+			changed = true;
+		}
+	}
+	if (m_schedule.due(e_pollBoundary, now))
+	{
+		std::vector<ovrVector3f> outer;
+		std::vector<ovrVector3f> play;
+		{
+			LatencyTimer timer(m_latency, e_latencyBoundary);
+			getBoundary(m_hmd, ovrBoundary_Outer, outer);
+			getBoundary(m_hmd, ovrBoundary_PlayArea, play);
+		}
+		if (!samePoints(outer, info.outerBoundary) || !samePoints(play, info.playArea))
+		{
+			info.outerBoundary.swap(outer);
+			info.playArea.swap(play);
+			changed = true;
+		}
+	}
+	return changed;
+}
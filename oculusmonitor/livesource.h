@@ -0,0 +1,44 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#pragma once
+#include "devicesource.h"
+#include "pollschedule.h"
+
+// Samples a live LibOVR session.
+// Tracking and input state are queried every sample, everything else on slower tiers.
+class LiveSource : public DeviceSource
+{
+public:
+	// Data sources polled less often than every sample.
+	enum PollTask
+	{
+		e_pollTrackerPoses,
+		e_pollTrackers,
+		e_pollControllers,
+		e_pollHmd,
+		e_pollBoundary,
+		e_pollTaskCount
+	};
+
+	LiveSource(ovrSession hmd);
+
+	virtual void begin();
+	virtual bool sample(VRState &state);
+	virtual bool pollDeviceInfo(DeviceInfo &info, double now);
+
+	// Set the rate of a slow polling tier. Only call while the sampler is stopped.
+	void setPollRate(PollTask task, double rateHz);
+
+protected:
+	ovrSession m_hmd;
+	PollSchedule m_schedule;
+	unsigned int m_connectedControllers;
+	unsigned int m_sensorCount;
+	ovrTrackerPose m_sensorPose[4];
+};
@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#include "mappedfile.h"
+#include <algorithm>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile() : m_data(0), m_size(0), m_file(INVALID_HANDLE_VALUE), m_mapping(0)
+{
+}
+#else
+MappedFile::MappedFile() : m_data(0), m_size(0)
+{
+}
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string &filename)
+{
+	close();
+#ifdef _WIN32
+	m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	LARGE_INTEGER size;
+	if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	m_mapping = CreateFileMappingA(m_file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!m_mapping)
+	{
+		close();
+		return false;
+	}
+	m_data = (const unsigned char *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!m_data)
+	{
+		close();
+		return false;
+	}
+	m_size = (size_t)size.QuadPart;
+#else
+	int file = ::open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0)
+	{
+		::close(file);
+		return false;
+	}
+	// The mapping keeps the file open, the descriptor isn't needed after this.
+	void *data = mmap(0, (size_t)info.st_size, PROT_READ, MAP_SHARED, file, 0);
+	::close(file);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+	m_data = (const unsigned char *)data;
+	m_size = (size_t)info.st_size;
+#endif
+	return true;
+}
+
+void MappedFile::prefetch(const unsigned char *data, size_t size) const
+{
+	if (!m_data || data < m_data || data >= m_data + m_size)
+	{
+		return;
+	}
+	size = std::min(size, (size_t)(m_data + m_size - data));
+#ifdef _WIN32
+	// PrefetchVirtualMemory is Windows 8 on, look it up rather than fail to start on 7. Its range struct is only
+	// declared when building for 8, so it's repeated here.
+	struct MemoryRange
+	{
+		void *address;
+		SIZE_T size;
+	};
+	typedef BOOL (WINAPI *PrefetchFunction)(HANDLE, ULONG_PTR, MemoryRange *, ULONG);
+	static const PrefetchFunction s_prefetch = (PrefetchFunction)GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory");
+	if (s_prefetch)
+	{
+		MemoryRange range = { (void *)data, size };
+		s_prefetch(GetCurrentProcess(), 1, &range, 0);
+	}
+#else
+	// madvise wants a page aligned start.
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t offset = (size_t)(data - m_data) % page;
+	madvise((void *)(data - offset), size + offset, MADV_WILLNEED);
+#endif
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+	m_mapping = 0;
+	m_file = INVALID_HANDLE_VALUE;
+#else
+	if (m_data)
+		munmap((void *)m_data, m_size);
+#endif
+	m_data = 0;
+	m_size = 0;
+}
@@ -0,0 +1,47 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Read only view of a whole file. Nothing is read up front, the OS pages the file in as it's touched.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool open(const std::string &filename);
+	void close();
+
+	const unsigned char *data() const
+	{
+		return m_data;
+	}
+
+	size_t size() const
+	{
+		return m_size;
+	}
+
+	// Start reading part of the file in the background, so touching it later doesn't wait on the disk. Only a hint,
+	// it does nothing where the OS doesn't support it.
+	void prefetch(const unsigned char *data, size_t size) const;
+
+protected:
+	MappedFile(const MappedFile &);
+	MappedFile &operator=(const MappedFile &);
+
+	const unsigned char *m_data;
+	size_t m_size;
+#ifdef _WIN32
+	void *m_file;
+	void *m_mapping;
+#endif
+};
@@ -0,0 +1,475 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+// Headless recorder. Runs the same capture pipeline as the monitor with no window, D3D or ImGui,
+// streaming samples straight to disk so long soak captures don't depend on the GUI.
+
+#include "vrstate.h"
+#include "sampler.h"
+#include "livesource.h"
+#include "synthsource.h"
+#include "samplestore.h"
+#include "recordingfile.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <memory>
+
+#pragma comment(lib,"LibOVR.lib")
+
+namespace
+{
+	volatile std::sig_atomic_t g_stop = 0;
+
+	void onSignal(int)
+	{
+		g_stop = 1;
+	}
+
+	void usage()
+	{
+		printf("omrecord [options]\n");
+		printf("  -out <file>          Output CSV file (default record.csv)\n");
+		printf("  -rate <hz>           Sample rate (default 500)\n");
+		printf("  -duration <seconds>  Stop after this long, 0 records until Ctrl+C (default 0)\n");
+		printf("  -adaptive <hz>       Drop to this rate while everything is still\n");
+		printf("  -status <seconds>    Progress report interval (default 10)\n");
+		printf("  -source live|synthetic\n");
+		printf("  -benchmark           Time recording compression on synthetic data instead of recording\n");
+		printf("  -verify <file.omr>   Check a recording's checksums instead of recording\n");
+		printf("Synthetic source:\n");
+		printf("  -seed <n>            Random seed (default 1)\n");
+		printf("  -realtime            Generate at the sample rate instead of as fast as possible\n");
+		printf("  -objects <n>         Number of VR Objects (default 0)\n");
+		printf("  -noise <scale>       Multiplier on the default sensor noise (default 1)\n");
+		printf("  -trackingloss <n>    Tracking loss events per device per minute (default 0)\n");
+		printf("  -dropouts <n>        Sensor dropouts per sensor per minute (default 0)\n");
+	}
+
+	void printLatency(const LatencyStats &latency)
+	{
+		printf("%-32s %10s %10s %10s %12s\n", "Call", "p50 (us)", "p99 (us)", "max (us)", "calls");
+		for (int i = 0; i < e_latencyCount; ++i)
+		{
+			const LatencyHistogram &histogram = latency.histogram((LatencyCall)i);
+			if (histogram.count() == 0)
+				continue;
+			printf("%-32s %10.1f %10.1f %10.1f %12llu\n", g_latencyCallNames[i], histogram.percentile(0.5) * 0.001, histogram.percentile(0.99) * 0.001, histogram.max() * 0.001, histogram.count());
+		}
+	}
+
+	// Packs the same synthetic recording each way and reads every column back, reporting size and throughput.
+	int benchmark(const SyntheticParams &params)
+	{
+		SyntheticSource source(params);
+		source.begin();
+		SampleStore raw;
+		VRState state;
+		while (source.sample(state))
+		{
+			state.time = state.runtimeTime;
+			raw.push_back(state);
+		}
+		if (raw.blockCount() < 2)
+		{
+			fprintf(stderr, "Not enough samples to benchmark\n");
+			return 1;
+		}
+		// Throughput is measured against the column data in full blocks, the last one is never packed.
+		size_t sampleBytes = 0;
+		for (int c = 0; c < e_columnCount; ++c)
+		{
+			sampleBytes += SampleStore::columnSize(c);
+		}
+		unsigned int blocks = raw.blockCount() - 1;
+		double dataMB = (double)blocks * SampleStore::c_blockSamples * sampleBytes / 1048576.0;
+		double rawMB = raw.memoryUsed() / 1048576.0;
+		printf("%u samples, %0.1f MB in memory uncompressed\n", raw.size(), rawMB);
+		printf("%-12s %10s %8s %14s %14s\n", "Mode", "MB", "Ratio", "Encode MB/s", "Decode MB/s");
+
+		typedef std::chrono::steady_clock Clock;
+		const char *names[] = { "Quantized", "Lossless" };
+		const Compression modes[] = { e_compressQuantized, e_compressLossless };
+		SampleStore packedModes[2];
+		for (int m = 0; m < 2; ++m)
+		{
+			SampleStore &packed = packedModes[m];
+			packed = raw;
+			Clock::time_point start = Clock::now();
+			packed.setCompression(modes[m]);
+			double encode = std::chrono::duration<double>(Clock::now() - start).count();
+			packed.releasePool();
+			double packedMB = packed.memoryUsed() / 1048576.0;
+
+			bool exact = true;
+			start = Clock::now();
+			for (unsigned int b = 0; b < blocks; ++b)
+			{
+				for (int c = 0; c < e_columnCount; ++c)
+				{
+					const unsigned char *data = packed.column<unsigned char>(b, c);
+					if (modes[m] == e_compressLossless && memcmp(data, raw.column<unsigned char>(b, c), SampleStore::columnSize(c) * SampleStore::c_blockSamples))
+					{
+						exact = false;
+					}
+				}
+			}
+			double decode = std::chrono::duration<double>(Clock::now() - start).count();
+			printf("%-12s %10.1f %8.2f %14.0f %14.0f\n", names[m], packedMB, rawMB / packedMB, dataMB / encode, dataMB / decode);
+			if (!exact)
+			{
+				fprintf(stderr, "Lossless decode doesn't match the recording\n");
+				return 1;
+			}
+
+			// Absent objects have zero orientations, which have to come back as zero rather than as a rotation.
+			for (unsigned int b = 0; b < blocks; ++b)
+			{
+				for (int d = 0; d < e_deviceCount; ++d)
+				{
+					int c = SampleStore::poseColumn(d, e_poseOrientation);
+					const ovrQuatf *before = raw.column<ovrQuatf>(b, c);
+					const ovrQuatf *after = packed.column<ovrQuatf>(b, c);
+					for (unsigned int i = 0; i < SampleStore::c_blockSamples; ++i)
+					{
+						bool zero = before[i].x == 0 && before[i].y == 0 && before[i].z == 0 && before[i].w == 0;
+						if (zero != (after[i].x == 0 && after[i].y == 0 && after[i].z == 0 && after[i].w == 0))
+						{
+							fprintf(stderr, "%s decode doesn't keep zero orientations\n", names[m]);
+							return 1;
+						}
+					}
+				}
+			}
+		}
+
+		// Unpacking the whole recording at once (SampleStore::unpackAll), on 1 thread up to one per core.
+		unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+		printf("\n%-8s %14s %14s\n", "Threads", "Quantized MB/s", "Lossless MB/s");
+		for (unsigned int threads = 1;; threads = std::min(threads * 2, cores))
+		{
+			printf("%-8u", threads);
+			for (int m = 0; m < 2; ++m)
+			{
+				SampleStore unpacked(packedModes[m]);
+				Clock::time_point start = Clock::now();
+				unpacked.unpackAll(threads);
+				double decode = std::chrono::duration<double>(Clock::now() - start).count();
+				printf(" %14.0f", dataMB / decode);
+				for (unsigned int b = 0; b < blocks && modes[m] == e_compressLossless; ++b)
+				{
+					for (int c = 0; c < e_columnCount; ++c)
+					{
+						if (memcmp(unpacked.column<unsigned char>(b, c), raw.column<unsigned char>(b, c), SampleStore::columnSize(c) * SampleStore::c_blockSamples) != 0)
+						{
+							fprintf(stderr, "\nLossless unpackAll doesn't match the recording\n");
+							return 1;
+						}
+					}
+				}
+			}
+			printf("\n");
+			if (threads == cores)
+			{
+				break;
+			}
+		}
+
+		// A saved recording that was cut short has no checkpoints to recover from, opening it should give up after
+		// searching the end of the file rather than reading all of it.
+		const char *saved = "omrecord_benchmark.omr";
+		const char *truncated = "omrecord_benchmark_truncated.omr";
+		StateManager recording;
+		recording.m_samples = packedModes[1];
+		std::string error;
+		if (!saveRecording(saved, recording, error))
+		{
+			fprintf(stderr, "%s\n", error.c_str());
+			return 1;
+		}
+		std::vector<char> bytes;
+		FILE *in = fopen(saved, "rb");
+		if (in)
+		{
+			fseek(in, 0, SEEK_END);
+			bytes.resize(ftell(in) * 3 / 4);
+			fseek(in, 0, SEEK_SET);
+			if (fread(&bytes[0], 1, bytes.size(), in) != bytes.size())
+			{
+				bytes.clear();
+			}
+			fclose(in);
+		}
+		FILE *out = fopen(truncated, "wb");
+		bool written = out && !bytes.empty() && fwrite(&bytes[0], 1, bytes.size(), out) == bytes.size();
+		if (out)
+		{
+			fclose(out);
+		}
+		remove(saved);
+		if (!written)
+		{
+			remove(truncated);
+			fprintf(stderr, "Can't write %s\n", truncated);
+			return 1;
+		}
+		StateManager opened;
+		Clock::time_point start = Clock::now();
+		bool recovered = openRecording(truncated, opened, error);
+		double open = std::chrono::duration<double>(Clock::now() - start).count();
+		remove(truncated);
+		if (recovered)
+		{
+			fprintf(stderr, "A truncated saved recording opened as if it had been streamed\n");
+			return 1;
+		}
+		printf("\nTruncated %0.1f MB recording rejected in %0.1f ms\n", bytes.size() / 1048576.0, open * 1000.0);
+		return 0;
+	}
+
+	// The check the monitor runs in the background after opening a recording.
+	int verify(const std::string &filename)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		RecordingCheck check;
+		check.start(filename);
+		while (check.busy())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		if (!check.error().empty())
+		{
+			fprintf(stderr, "%s\n", check.error().c_str());
+			return 1;
+		}
+		const std::vector<unsigned int> &damaged = check.damaged();
+		printf("%u blocks checked in %.2f s, %u damaged\n", check.blocks(), std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), (unsigned int)damaged.size());
+		for (size_t i = 0; i < damaged.size(); ++i)
+		{
+			unsigned int first = damaged[i] * SampleStore::c_blockSamples;
+			printf("  Block %u, samples %u to %u\n", damaged[i], first, first + SampleStore::c_blockSamples - 1);
+		}
+		return damaged.empty() ? 0 : 2;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	std::string filename = "record.csv";
+	double rate = 500.0;
+	double duration = 0;
+	double idleRate = 0;
+	double statusInterval = 10.0;
+	bool synthetic = false;
+	bool runBenchmark = false;
+	std::string verifyFile;
+	float noise = 1.0f;
+	SyntheticParams params;
+	params.realtime = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "-out" && hasValue)
+			filename = argv[++i];
+		else if (arg == "-rate" && hasValue)
+			rate = atof(argv[++i]);
+		else if (arg == "-duration" && hasValue)
+			duration = atof(argv[++i]);
+		else if (arg == "-adaptive" && hasValue)
+			idleRate = atof(argv[++i]);
+		else if (arg == "-status" && hasValue)
+			statusInterval = atof(argv[++i]);
+		else if (arg == "-source" && hasValue && (strcmp(argv[i + 1], "live") == 0 || strcmp(argv[i + 1], "synthetic") == 0))
+			synthetic = strcmp(argv[++i], "synthetic") == 0;
+		else if (arg == "-benchmark")
+			runBenchmark = true;
+		else if (arg == "-verify" && hasValue)
+			verifyFile = argv[++i];
+		else if (arg == "-seed" && hasValue)
+			params.seed = strtoull(argv[++i], 0, 10);
+		else if (arg == "-realtime")
+			params.realtime = true;
+		else if (arg == "-objects" && hasValue)
+			params.objectCount = atoi(argv[++i]);
+		else if (arg == "-noise" && hasValue)
+			noise = (float)atof(argv[++i]);
+		else if (arg == "-trackingloss" && hasValue)
+			params.trackingLossRate = (float)atof(argv[++i]);
+		else if (arg == "-dropouts" && hasValue)
+			params.sensorDropoutRate = (float)atof(argv[++i]);
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	if (rate <= 0)
+	{
+		usage();
+		return 1;
+	}
+	if (!verifyFile.empty())
+	{
+		return verify(verifyFile);
+	}
+	params.rate = rate;
+	params.duration = duration;
+	params.positionNoise *= noise;
+	params.orientationNoise *= noise;
+	params.velocityNoise *= noise;
+	params.angularVelocityNoise *= noise;
+	params.accelerationNoise *= noise;
+	if (runBenchmark)
+	{
+		if (duration <= 0)
+			params.duration = 600.0;
+		params.realtime = false;
+		return benchmark(params);
+	}
+
+	ovrSession hmd = 0;
+	std::unique_ptr<DeviceSource> source;
+	if (synthetic)
+	{
+		source.reset(new SyntheticSource(params));
+	}
+	else
+	{
+		ovrInitParams initParams = {};
+		initParams.Flags = ovrInit_Invisible;
+		ovrResult result = ovr_Initialize(&initParams);
+		if (OVR_FAILURE(result))
+		{
+			fprintf(stderr, "Failed to initialise LibOVR\n");
+			return 1;
+		}
+		ovrGraphicsLuid luid;
+		result = ovr_Create(&hmd, &luid);
+		if (OVR_FAILURE(result))
+		{
+			fprintf(stderr, "No headset found\n");
+			ovr_Shutdown();
+			return 1;
+		}
+		ovr_SetTrackingOriginType(hmd, ovrTrackingOrigin_FloorLevel);
+		source.reset(new LiveSource(hmd));
+	}
+
+	std::ofstream out(filename);
+	if (!out)
+	{
+		fprintf(stderr, "Can't write %s\n", filename.c_str());
+		return 1;
+	}
+	out << std::setprecision(15);
+	StateManager::writeCSVHeader(out);
+
+	std::signal(SIGINT, onSignal);
+	std::signal(SIGTERM, onSignal);
+
+	Sampler sampler;
+	sampler.setAdaptive(idleRate > 0, idleRate, 0.05f, 0.2f);
+	sampler.start(source.get(), rate);
+	printf("Recording to %s at %g Hz%s, Ctrl+C to stop\n", filename.c_str(), rate, synthetic ? " (synthetic)" : "");
+
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point lastFlush = Clock::now();
+	Clock::time_point lastStatus = lastFlush;
+	unsigned long long written = 0;
+	unsigned long long repeats = 0;
+	bool started = false;
+	double firstRuntimeTime = 0;
+	double recordTime = 0;
+	JitterMonitor jitter;
+	VRState last;
+	VRState sample;
+	while (!g_stop)
+	{
+		// Check before draining, so nothing pushed just before the source finished is lost.
+		bool finished = sampler.finished();
+		// Bounded, so a source running faster than the file can be written doesn't starve the status and flush.
+		unsigned int count = 0;
+		while (count++ < 4096 && sampler.pop(sample))
+		{
+			if (!started)
+			{
+				firstRuntimeTime = sample.runtimeTime;
+				started = true;
+			}
+			sample.time = sample.runtimeTime - firstRuntimeTime;
+			jitter.update(sample.wallTime, sample.runtimeTime, sample.sampleRate, sample.lateness);
+			recordTime = sample.time;
+			if (duration > 0 && sample.time > duration)
+			{
+				g_stop = 1;
+				break;
+			}
+			// Same rule as StateManager::record, only the first of a run of identical samples is kept.
+			if (written > 0 && StateManager::isRepeat(last, sample))
+			{
+				repeats++;
+				continue;
+			}
+			last = sample;
+			StateManager::writeCSVRow(out, sample, sample.sampleRate);
+			written++;
+		}
+		if (finished && count <= 4096)
+		{
+			break;
+		}
+
+		Clock::time_point now = Clock::now();
+		if (now - lastFlush >= std::chrono::seconds(1))
+		{
+			// Keep what has been captured so far on disk in case the process dies.
+			out.flush();
+			lastFlush = now;
+		}
+		if (statusInterval > 0 && std::chrono::duration<double>(now - lastStatus).count() >= statusInterval)
+		{
+			printf("%10.1fs %12llu samples %8.1f Hz %8u dropped %12llu repeats %8.1fus jitter %10llu late\n", recordTime, written, sampler.achievedRate(), sampler.dropped(), repeats, jitter.jitter(), jitter.m_late);
+			fflush(stdout);
+			lastStatus = now;
+		}
+		if (synthetic && !params.realtime)
+		{
+			// Generating faster than real time, the sampler is waiting on us.
+			std::this_thread::yield();
+		}
+		else
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+	}
+
+	sampler.stop();
+	out.flush();
+	printf("%10.1fs %12llu samples %8u dropped %12llu repeats %10llu late (max %0.1fus)\n", recordTime, written, sampler.dropped(), repeats, jitter.m_late, jitter.m_maxLateness);
+	printLatency(sampler.latency());
+	if (!out)
+	{
+		fprintf(stderr, "Error writing %s\n", filename.c_str());
+	}
+
+	if (hmd)
+	{
+		ovr_Destroy(hmd);
+		ovr_Shutdown();
+	}
+	return out ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#pragma once
+#include <vector>
+
+// Decides which of a set of data sources are due to be polled.
+// Each source has its own rate, and can be forced to refresh early (eg. when a related source changed).
+class PollSchedule
+{
+public:
+	PollSchedule(int count) : m_period(count, 0.0), m_next(count, 0.0)
+	{
+	}
+
+	// A rate of 0 means poll every time.
+	void setRate(int task, double rateHz)
+	{
+		m_period[task] = rateHz > 0 ? 1.0 / rateHz : 0.0;
+	}
+
+	double rate(int task) const
+	{
+		return m_period[task] > 0 ? 1.0 / m_period[task] : 0.0;
+	}
+
+	void trigger(int task)
+	{
+		m_next[task] = 0;
+	}
+
+	bool due(int task, double now)
+	{
+		if (now < m_next[task])
+		{
+			return false;
+		}
+		m_next[task] = now + m_period[task];
+		return true;
+	}
+
+protected:
+	std::vector<double> m_period;
+	std::vector<double> m_next;
+};
@@ -0,0 +1,849 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#include "recordingfile.h"
+#include "vrstate.h"
+#include "mappedfile.h"
+#include "crc32c.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+// File layout:
+//   RecordingHeader
+//   Sample blocks as SampleStore holds them, packed or not, each starting on a cache line
+//   Metadata: device epochs, rate segments, then button edges
+//   Block index, a FileBlock per block
+//   RecordingFooter
+// Structs are written as the compiler lays them out (little endian, x64), c_version changes whenever any of them or
+// the column layout does. The metadata and index come after the samples so a file can be written as it's recorded.
+//
+// A file streamed while recording is only appended to. Each block has a BlockRecord in front of it, and every
+// c_checkpointBlocks blocks a CheckpointRecord lists block records, epochs and rate segments. Every
+// c_fullCheckpointBlocks blocks one lists everything from the start; the ones in between list everything since that
+// full one and point back to it, so none of them gets long. If the program stops before the tail is written, opening
+// the file finds the last checkpoint by looking back from the end, reads it and the full one it points to, then
+// steps forward over any block records written after them. Only the last few blocks' worth of the file is searched,
+// however long the recording, and each block record is read once but the samples never are. A file with no
+// checkpoint there fails at once.
+// The recovered tail is then appended so the file opens normally from then on.
+
+namespace
+{
+	const char c_magic[8] = { 'O', 'M', 'R', 'E', 'C', '\r', '\n', '\x1a' };	// Line ends catch text mode transfers
+	const char c_checkpointMagic[8] = { 'O', 'M', 'C', 'H', 'E', 'C', 'K', '1' };
+	const unsigned int c_version = 5;
+	const unsigned int c_recordAlignment = 64;		// Block and checkpoint records start on a cache line
+	const unsigned int c_checkpointBlocks = 4;
+	const unsigned int c_fullCheckpointBlocks = 256;
+	const unsigned long long c_maxCheckpointSearch = 64 << 20;	// Bytes back from the end, at most
+
+	struct RecordingHeader
+	{
+		char magic[8];
+		unsigned int version;
+		unsigned int blockSamples;
+		unsigned int columnCount;
+		unsigned int columnSizes[e_columnCount];
+	};
+
+	struct RecordingFooter
+	{
+		unsigned long long metadataOffset;
+		unsigned long long indexOffset;
+		unsigned int blockCount;
+		unsigned int sampleCount;
+		unsigned int version;
+		unsigned int crc;		// CRC32-C of the metadata and index
+		char magic[8];			// Last, so a file cut short doesn't end with it
+	};
+
+	// Followed by the offsets of blockCount BlockRecords, epochCount epochs, then rateCount RateSegments.
+	struct CheckpointRecord
+	{
+		char magic[8];
+		unsigned int crc;				// CRC32-C of the rest of the checkpoint
+		unsigned int blockCount;
+		unsigned long long base;		// Offset of the full checkpoint this lists everything since, 0 if it lists everything
+		unsigned long long bytes;		// Including what follows
+		unsigned int epochCount;
+		unsigned int rateCount;
+	};
+
+	// Everything a file holds besides the samples.
+	struct Metadata
+	{
+		std::vector<DeviceEpoch> epochs;
+		std::vector<RateSegment> rateSegments;
+		std::vector<ButtonEdge> edges[e_buttonFieldCount];
+		unsigned int sampleCount;
+
+		Metadata() : sampleCount(0)
+		{
+		}
+
+		explicit Metadata(const StateManager &state) : epochs(state.m_epochs), rateSegments(state.m_rateSegments), sampleCount(state.m_samples.size())
+		{
+			for (int i = 0; i < e_buttonFieldCount; ++i)
+			{
+				edges[i] = state.m_samples.edges((ButtonField)i);
+			}
+		}
+	};
+
+	class BufferWriter
+	{
+	public:
+		template<typename T>
+		void put(const T &value)
+		{
+			put(&value, sizeof(T));
+		}
+
+		template<typename T>
+		void putArray(const std::vector<T> &values)
+		{
+			put((unsigned int)values.size());
+			if (!values.empty())
+				put(&values[0], values.size() * sizeof(T));
+		}
+
+		void put(const void *data, size_t size)
+		{
+			m_data.insert(m_data.end(), (const unsigned char *)data, (const unsigned char *)data + size);
+		}
+
+		std::vector<unsigned char> m_data;
+	};
+
+	// Reads from mapped memory, failing rather than reading past the end.
+	class BufferReader
+	{
+	public:
+		BufferReader(const unsigned char *data, size_t size) : m_data(data), m_left(size)
+		{
+		}
+
+		template<typename T>
+		bool get(T &value)
+		{
+			return get(&value, sizeof(T));
+		}
+
+		template<typename T>
+		bool getArray(std::vector<T> &values)
+		{
+			unsigned int count;
+			if (!get(count) || count > m_left / sizeof(T))
+				return false;
+			values.resize(count);
+			return count == 0 || get(&values[0], count * sizeof(T));
+		}
+
+		bool get(void *data, size_t size)
+		{
+			if (size > m_left)
+				return false;
+			memcpy(data, m_data, size);
+			m_data += size;
+			m_left -= size;
+			return true;
+		}
+
+	protected:
+		const unsigned char *m_data;
+		size_t m_left;
+	};
+
+	void writeDeviceInfo(BufferWriter &out, const DeviceInfo &info)
+	{
+		out.put(info.version);
+		out.put(info.hmdDesc);
+		out.put(info.trackingOrigin);
+		out.put(info.connectedControllers);
+		out.put(info.sensorCount);
+		out.put(info.sensorDesc);
+		out.putArray(info.outerBoundary);
+		out.putArray(info.playArea);
+	}
+
+	bool readDeviceInfo(BufferReader &in, DeviceInfo &info)
+	{
+		return in.get(info.version) && in.get(info.hmdDesc) && in.get(info.trackingOrigin) && in.get(info.connectedControllers) &&
+			in.get(info.sensorCount) && in.get(info.sensorDesc) && in.getArray(info.outerBoundary) && in.getArray(info.playArea);
+	}
+
+	void writeEpoch(BufferWriter &out, const DeviceEpoch &epoch)
+	{
+		out.put(epoch.start);
+		writeDeviceInfo(out, epoch.info ? *epoch.info : DeviceInfo());
+	}
+
+	bool readEpoch(BufferReader &in, DeviceEpoch &epoch)
+	{
+		std::shared_ptr<DeviceInfo> info = std::make_shared<DeviceInfo>();
+		epoch.info = info;
+		return in.get(epoch.start) && readDeviceInfo(in, *info);
+	}
+
+	void writeHeader(BufferWriter &out)
+	{
+		RecordingHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, c_magic, sizeof(c_magic));
+		header.version = c_version;
+		header.blockSamples = SampleStore::c_blockSamples;
+		header.columnCount = e_columnCount;
+		for (int i = 0; i < e_columnCount; ++i)
+		{
+			header.columnSizes[i] = (unsigned int)SampleStore::columnSize(i);
+		}
+		out.put(header);
+	}
+
+	// Metadata, block index and footer, for a file where the blocks end at offset.
+	void writeTail(BufferWriter &out, const Metadata &metadata, unsigned long long offset, const std::vector<FileBlock> &index)
+	{
+		out.put((unsigned int)metadata.epochs.size());
+		for (size_t i = 0; i < metadata.epochs.size(); ++i)
+		{
+			writeEpoch(out, metadata.epochs[i]);
+		}
+		out.putArray(metadata.rateSegments);
+		for (int i = 0; i < e_buttonFieldCount; ++i)
+		{
+			out.putArray(metadata.edges[i]);
+		}
+
+		RecordingFooter footer;
+		memset(&footer, 0, sizeof(footer));
+		footer.metadataOffset = offset;
+		footer.indexOffset = offset + out.m_data.size();
+		footer.blockCount = (unsigned int)index.size();
+		footer.sampleCount = metadata.sampleCount;
+		footer.version = c_version;
+		memcpy(footer.magic, c_magic, sizeof(c_magic));
+		if (!index.empty())
+			out.put(&index[0], index.size() * sizeof(FileBlock));
+		footer.crc = crc32c(&out.m_data[0], out.m_data.size());
+		out.put(footer);
+	}
+
+	bool readMetadata(BufferReader &in, Metadata &metadata)
+	{
+		unsigned int epochCount = 0;
+		bool valid = in.get(epochCount);
+		for (unsigned int i = 0; valid && i < epochCount; ++i)
+		{
+			DeviceEpoch epoch;
+			valid = readEpoch(in, epoch);
+			metadata.epochs.push_back(epoch);
+		}
+		valid = valid && in.getArray(metadata.rateSegments);
+		for (int i = 0; valid && i < e_buttonFieldCount; ++i)
+		{
+			valid = in.getArray(metadata.edges[i]);
+		}
+		return valid;
+	}
+
+	// rename() won't replace an existing file on Windows.
+	bool replaceFile(const std::string &from, const std::string &to)
+	{
+#ifdef _WIN32
+		return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		return rename(from.c_str(), to.c_str()) == 0;
+#endif
+	}
+
+	// A raw block is the column arrays, so it has to reach the end of the last one.
+	size_t rawBlockBytes()
+	{
+		return SampleStore::columnOffset(e_columnCount - 1) + SampleStore::columnSize(e_columnCount - 1) * SampleStore::c_blockSamples;
+	}
+
+	// True if block can be read as described, and lies between the header and end.
+	bool validBlock(const FileBlock &block, unsigned long long end)
+	{
+		bool valid = block.offset >= sizeof(RecordingHeader) && block.offset + block.bytes <= end;
+		if (block.packing == e_compressNone)
+		{
+			return valid && block.bytes >= rawBlockBytes();
+		}
+		valid = valid && block.packing <= e_compressLossless && block.start[e_columnCount] == block.bytes;
+		for (int c = 0; valid && c < e_columnCount; ++c)
+		{
+			valid = block.start[c] <= block.start[c + 1];
+		}
+		return valid;
+	}
+
+	unsigned long long alignRecord(unsigned long long offset)
+	{
+		return (offset + c_recordAlignment - 1) & ~(unsigned long long)(c_recordAlignment - 1);
+	}
+
+	// Reads the block record at offset if a whole one is there, block included, and checks the block's checksum as
+	// well if checkBlock is set. Its edges are added to edges if that isn't null.
+	bool readBlockRecord(const unsigned char *data, size_t size, unsigned long long offset, BlockRecord &record, std::vector<ButtonEdge> *edges, bool checkBlock = false)
+	{
+		if (offset < sizeof(RecordingHeader) || offset % c_recordAlignment || offset + sizeof(record) > size)
+		{
+			return false;
+		}
+		memcpy(&record, data + offset, sizeof(record));
+		unsigned long long bytes = sizeof(record);
+		for (int i = 0; i < e_buttonFieldCount; ++i)
+		{
+			bytes += (unsigned long long)record.edgeCount[i] * sizeof(ButtonEdge);
+		}
+		if (memcmp(record.magic, g_blockRecordMagic, sizeof(record.magic)) != 0 || record.samples == 0 || record.samples > SampleStore::c_blockSamples ||
+			record.block.offset != alignRecord(offset + bytes) || !validBlock(record.block, size))
+		{
+			return false;
+		}
+		size_t checked = offsetof(BlockRecord, crc) + sizeof(record.crc);
+		if (crc32c(data + offset + checked, (size_t)bytes - checked) != record.crc ||
+			(checkBlock && crc32c(data + record.block.offset, record.block.bytes) != record.block.crc))
+		{
+			return false;
+		}
+		const ButtonEdge *in = (const ButtonEdge *)(data + offset + sizeof(record));
+		for (int i = 0; edges && i < e_buttonFieldCount; ++i)
+		{
+			edges[i].insert(edges[i].end(), in, in + record.edgeCount[i]);
+			in += record.edgeCount[i];
+		}
+		return true;
+	}
+
+	// Reads the checkpoint at offset if a whole one is there. The block records it lists aren't looked at.
+	bool readCheckpoint(const unsigned char *data, size_t size, unsigned long long offset, CheckpointRecord &record)
+	{
+		if (offset % c_recordAlignment || offset + sizeof(record) > size)
+		{
+			return false;
+		}
+		memcpy(&record, data + offset, sizeof(record));
+		if (memcmp(record.magic, c_checkpointMagic, sizeof(c_checkpointMagic)) != 0 || record.bytes < sizeof(record) || record.bytes > size - offset ||
+			record.base >= offset || record.blockCount > (record.bytes - sizeof(record)) / sizeof(unsigned long long))
+		{
+			return false;
+		}
+		size_t checked = offsetof(CheckpointRecord, crc) + sizeof(record.crc);
+		return crc32c(data + offset + checked, (size_t)record.bytes - checked) == record.crc;
+	}
+
+	// Adds the block record offsets, epochs and rate segments a checkpoint lists.
+	bool readCheckpointLists(const unsigned char *data, unsigned long long offset, const CheckpointRecord &record, std::vector<unsigned long long> &records, Metadata &metadata)
+	{
+		BufferReader in(data + offset + sizeof(record), (size_t)(record.bytes - sizeof(record)));
+		for (unsigned int i = 0; i < record.blockCount; ++i)
+		{
+			unsigned long long blockOffset;
+			in.get(blockOffset);
+			records.push_back(blockOffset);
+		}
+		for (unsigned int i = 0; i < record.epochCount; ++i)
+		{
+			DeviceEpoch epoch;
+			if (!readEpoch(in, epoch))
+			{
+				return false;
+			}
+			metadata.epochs.push_back(epoch);
+		}
+		for (unsigned int i = 0; i < record.rateCount; ++i)
+		{
+			RateSegment segment;
+			if (!in.get(segment))
+			{
+				return false;
+			}
+			metadata.rateSegments.push_back(segment);
+		}
+		return true;
+	}
+
+	// Rebuilds the index and metadata of a streamed file that was never finished. See the top of the file.
+	bool recoverRecording(const unsigned char *data, size_t size, std::vector<FileBlock> &index, Metadata &metadata)
+	{
+		// Checkpoints are at most c_checkpointBlocks blocks apart, so the last one is within a few blocks of the end.
+		// If there's none there, the file is either only a few blocks long or wasn't streamed at all.
+		unsigned long long first = alignRecord(sizeof(RecordingHeader));
+		unsigned long long search = std::min<unsigned long long>(c_maxCheckpointSearch,
+			(c_checkpointBlocks + 1) * (SampleStore::maxBlockBytes() + sizeof(BlockRecord) + c_recordAlignment));
+		unsigned long long end = size & ~(unsigned long long)(c_recordAlignment - 1);
+		unsigned long long stop = end > first + search ? end - search : first;
+		unsigned long long last = 0;
+		CheckpointRecord record;
+		for (unsigned long long offset = end; offset >= stop && !last; offset -= c_recordAlignment)
+		{
+			if (readCheckpoint(data, size, offset, record))
+			{
+				last = offset;
+			}
+		}
+		if (!last && stop > first)
+		{
+			return false;
+		}
+
+		// The last checkpoint lists what came after the full one it carries on from, so at most two are read.
+		std::vector<unsigned long long> records;
+		if (last)
+		{
+			CheckpointRecord base;
+			if (record.base && (!readCheckpoint(data, size, record.base, base) || base.base || !readCheckpointLists(data, record.base, base, records, metadata)))
+			{
+				return false;
+			}
+			if (!readCheckpointLists(data, last, record, records, metadata))
+			{
+				return false;
+			}
+		}
+
+		// Then each block record once and in order: the listed ones, then any written after them up to the first
+		// that didn't get written completely, stepping over checkpoints. Only the blocks past the last checkpoint
+		// have their samples checked here, the OS may have extended the file without writing all of them.
+		BlockRecord block;
+		unsigned long long next = first;
+		for (size_t i = 0;; ++i)
+		{
+			bool listed = i < records.size();
+			unsigned long long offset = listed ? records[i] : next;
+			while (!listed && readCheckpoint(data, size, offset, record))
+			{
+				offset = alignRecord(offset + record.bytes);
+			}
+			if (offset < next || !readBlockRecord(data, size, offset, block, metadata.edges, offset > last))
+			{
+				// Listed blocks can still be missing if the OS wrote the checkpoint first, the recording ends there.
+				break;
+			}
+			if (metadata.sampleCount % SampleStore::c_blockSamples != 0)
+			{
+				// Only the last block can be partly filled.
+				return false;
+			}
+			index.push_back(block.block);
+			metadata.sampleCount += block.samples;
+			next = alignRecord(block.block.offset + block.block.bytes);
+		}
+		if (index.empty())
+		{
+			// Not streamed, or nothing was written.
+			return false;
+		}
+
+		// Epochs and rates may have started in blocks that didn't make it.
+		while (!metadata.epochs.empty() && metadata.epochs.back().start >= metadata.sampleCount)
+		{
+			metadata.epochs.pop_back();
+		}
+		while (!metadata.rateSegments.empty() && metadata.rateSegments.back().start >= metadata.sampleCount)
+		{
+			metadata.rateSegments.pop_back();
+		}
+		return true;
+	}
+
+	// Reads the index and metadata from the footer of a finished file.
+	bool readTail(const unsigned char *data, size_t size, const RecordingFooter &footer, std::vector<FileBlock> &index, Metadata &metadata)
+	{
+		// Everything the footer points at has to be inside the file and in order.
+		unsigned long long footerOffset = size - sizeof(footer);
+		unsigned long long blocks = footer.blockCount;
+		bool valid = footer.metadataOffset >= sizeof(RecordingHeader) && footer.metadataOffset <= footer.indexOffset && footer.indexOffset <= footerOffset &&
+			blocks * sizeof(FileBlock) == footerOffset - footer.indexOffset &&
+			footer.sampleCount <= blocks * SampleStore::c_blockSamples && footer.sampleCount + SampleStore::c_blockSamples > blocks * SampleStore::c_blockSamples &&
+			crc32c(data + footer.metadataOffset, (size_t)(footerOffset - footer.metadataOffset)) == footer.crc;
+		index.resize(valid ? footer.blockCount : 0);
+		if (!index.empty())
+		{
+			memcpy(&index[0], data + footer.indexOffset, index.size() * sizeof(FileBlock));
+		}
+		for (size_t i = 0; valid && i < index.size(); ++i)
+		{
+			valid = validBlock(index[i], footer.metadataOffset);
+		}
+		BufferReader in(data + footer.metadataOffset, valid ? (size_t)(footer.indexOffset - footer.metadataOffset) : 0);
+		metadata.sampleCount = footer.sampleCount;
+		return valid && readMetadata(in, metadata);
+	}
+
+	// Appends the tail of a recovered file, so it opens normally next time. Anything after the last whole record
+	// stays where it is, the footer says where the tail starts.
+	bool appendTail(const std::string &filename, unsigned long long size, const std::vector<FileBlock> &index, const Metadata &metadata)
+	{
+		FILE *file = fopen(filename.c_str(), "ab");
+		if (!file)
+		{
+			return false;
+		}
+		BufferWriter tail;
+		writeTail(tail, metadata, size, index);
+		bool written = fwrite(&tail.m_data[0], tail.m_data.size(), 1, file) == 1;
+		return fclose(file) == 0 && written;
+	}
+
+	// Reads the index and metadata of a mapped recording, recovering them if the file was never finished.
+	bool readRecording(const MappedFile &file, const std::string &filename, std::vector<FileBlock> &index, Metadata &metadata, bool &unfinished, std::string &error)
+	{
+		const unsigned char *data = file.data();
+		size_t size = file.size();
+		RecordingHeader header;
+		RecordingFooter footer;
+		if (size < sizeof(header))
+		{
+			error = filename + " is not a recording";
+			return false;
+		}
+		memcpy(&header, data, sizeof(header));
+		if (memcmp(header.magic, c_magic, sizeof(c_magic)) != 0)
+		{
+			error = filename + " is not a recording";
+			return false;
+		}
+		if (header.version != c_version)
+		{
+			error = filename + " is from a different version of the monitor";
+			return false;
+		}
+		bool layoutMatches = header.blockSamples == SampleStore::c_blockSamples && header.columnCount == e_columnCount;
+		for (int i = 0; layoutMatches && i < e_columnCount; ++i)
+		{
+			layoutMatches = header.columnSizes[i] == SampleStore::columnSize(i);
+		}
+		if (!layoutMatches)
+		{
+			error = filename + " was recorded with a different sample layout";
+			return false;
+		}
+
+		if (size >= sizeof(header) + sizeof(footer))
+		{
+			memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+		}
+		unfinished = size < sizeof(header) + sizeof(footer) || memcmp(footer.magic, c_magic, sizeof(c_magic)) != 0 || footer.version != c_version;
+		if (unfinished)
+		{
+			// Streamed, but never finished.
+			if (!recoverRecording(data, size, index, metadata))
+			{
+				error = filename + " is incomplete, the recording wasn't finished and can't be recovered";
+				return false;
+			}
+		}
+		else if (!readTail(data, size, footer, index, metadata))
+		{
+			error = filename + " is damaged";
+			return false;
+		}
+		return true;
+	}
+}
+
+bool saveRecording(const std::string &filename, const StateManager &state, std::string &error)
+{
+	// Written alongside and moved into place at the end, the recording may be mapped from the file being replaced.
+	std::string temporary = filename + ".tmp";
+	FILE *file = fopen(temporary.c_str(), "wb");
+	if (!file)
+	{
+		error = "Can't create " + filename;
+		return false;
+	}
+
+	BufferWriter header;
+	writeHeader(header);
+	bool written = fwrite(&header.m_data[0], header.m_data.size(), 1, file) == 1;
+
+	unsigned long long offset = header.m_data.size();
+	std::vector<FileBlock> index;
+	written = written && state.m_samples.writeBlocks(file, offset, index);
+
+	BufferWriter tail;
+	writeTail(tail, Metadata(state), offset, index);
+	written = written && fwrite(&tail.m_data[0], tail.m_data.size(), 1, file) == 1;
+	if (fclose(file) != 0 || !written)
+	{
+		remove(temporary.c_str());
+		error = "Error writing " + filename;
+		return false;
+	}
+	if (!replaceFile(temporary, filename))
+	{
+		remove(temporary.c_str());
+		error = "Can't replace " + filename + ", it may be open";
+		return false;
+	}
+	return true;
+}
+
+bool openRecording(const std::string &filename, StateManager &state, std::string &error, bool *recovered)
+{
+	if (recovered)
+	{
+		*recovered = false;
+	}
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+	if (!file->open(filename))
+	{
+		error = "Can't open " + filename;
+		return false;
+	}
+	std::vector<FileBlock> index;
+	Metadata metadata;
+	bool unfinished;
+	if (!readRecording(*file, filename, index, metadata, unfinished, error))
+	{
+		return false;
+	}
+	if (unfinished)
+	{
+		if (recovered)
+		{
+			*recovered = true;
+		}
+		// The mapping has to go before the file can be added to on Windows. If it can't be written the recovered
+		// recording is still used, it just has to be recovered again next time.
+		unsigned long long size = file->size();
+		file->close();
+		appendTail(filename, size, index, metadata);
+		if (!file->open(filename))
+		{
+			error = "Can't open " + filename;
+			return false;
+		}
+	}
+
+	state.reset();
+	state.m_samples.mapBlocks(file, index, metadata.sampleCount);
+	state.m_epochs = metadata.epochs;
+	state.m_rateSegments = metadata.rateSegments;
+	for (int i = 0; i < e_buttonFieldCount; ++i)
+	{
+		state.m_samples.setEdges((ButtonField)i, metadata.edges[i]);
+	}
+	return true;
+}
+
+RecordingStream::RecordingStream() : m_end(0), m_finished(false), m_base(0), m_baseBlocks(0), m_baseEpochs(0), m_baseRates(0), m_checkpointBlocks(0), m_checkpointEpochs(0), m_checkpointRates(0)
+{
+}
+
+bool RecordingStream::open(const std::string &filename, StateManager &state, std::string &error)
+{
+	// The last file's writes point at our buffers.
+	if (m_file)
+	{
+		m_file->flush();
+	}
+	m_file.reset();
+	m_checkpoints.clear();
+	m_filename = filename;
+	m_finished = false;
+	m_base = 0;
+	m_baseBlocks = 0;
+	m_baseEpochs = 0;
+	m_baseRates = 0;
+	m_checkpointBlocks = 0;
+	m_checkpointEpochs = 0;
+	m_checkpointRates = 0;
+	m_file = std::make_shared<SpillFile>();
+	if (!m_file->open(filename))
+	{
+		error = "Can't create " + filename;
+		m_file.reset();
+		return false;
+	}
+	BufferWriter header;
+	writeHeader(header);
+	m_header.swap(header.m_data);
+	m_file->append(&m_header[0], m_header.size());
+	state.m_samples.streamTo(m_file);
+	return true;
+}
+
+void RecordingStream::update(const StateManager &state)
+{
+	if (!active())
+	{
+		return;
+	}
+	while (!m_checkpoints.empty() && m_checkpoints.front().end <= m_file->written())
+	{
+		m_checkpoints.pop_front();
+	}
+
+	// Every c_checkpointBlocks blocks, or sooner if the device or rate changed, so little is lost with them. A backlog
+	// queued all at once still gets one per c_checkpointBlocks blocks.
+	for (;;)
+	{
+		unsigned int blocks = state.m_samples.queuedBlocks();
+		bool changed = state.m_epochs.size() > m_checkpointEpochs || state.m_rateSegments.size() > m_checkpointRates;
+		if (blocks < m_checkpointBlocks + (changed ? 1 : c_checkpointBlocks))
+		{
+			return;
+		}
+		checkpoint(state, std::min(blocks, m_checkpointBlocks + c_checkpointBlocks));
+	}
+}
+
+void RecordingStream::checkpoint(const StateManager &state, unsigned int blocks)
+{
+	// Lists everything since the last full checkpoint, or everything if this is to be the next full one.
+	bool full = blocks - m_baseBlocks >= c_fullCheckpointBlocks;
+	unsigned int fromBlock = full ? 0 : m_baseBlocks;
+	unsigned int fromEpoch = full ? 0 : m_baseEpochs;
+	unsigned int fromRate = full ? 0 : m_baseRates;
+	BufferWriter out;
+	CheckpointRecord record;
+	memset(&record, 0, sizeof(record));
+	memcpy(record.magic, c_checkpointMagic, sizeof(c_checkpointMagic));
+	record.base = full ? 0 : m_base;
+	record.blockCount = blocks - fromBlock;
+	record.epochCount = (unsigned int)state.m_epochs.size() - fromEpoch;
+	record.rateCount = (unsigned int)state.m_rateSegments.size() - fromRate;
+	out.put(record);
+	for (unsigned int i = fromBlock; i < blocks; ++i)
+	{
+		out.put((unsigned long long)state.m_samples.recordOffset(i));
+	}
+	for (size_t i = fromEpoch; i < state.m_epochs.size(); ++i)
+	{
+		writeEpoch(out, state.m_epochs[i]);
+	}
+	for (size_t i = fromRate; i < state.m_rateSegments.size(); ++i)
+	{
+		out.put(state.m_rateSegments[i]);
+	}
+	CheckpointRecord *written = (CheckpointRecord *)&out.m_data[0];
+	written->bytes = out.m_data.size();
+	size_t checked = offsetof(CheckpointRecord, crc) + sizeof(written->crc);
+	written->crc = crc32c(&out.m_data[checked], out.m_data.size() - checked);
+
+	m_checkpoints.push_back(Checkpoint());
+	Checkpoint &checkpoint = m_checkpoints.back();
+	checkpoint.data.swap(out.m_data);
+	unsigned long long offset = m_file->append(&checkpoint.data[0], checkpoint.data.size(), c_recordAlignment);
+	checkpoint.end = m_file->queued();
+	m_checkpointBlocks = blocks;
+	m_checkpointEpochs = (unsigned int)state.m_epochs.size();
+	m_checkpointRates = (unsigned int)state.m_rateSegments.size();
+	if (full)
+	{
+		m_base = offset;
+		m_baseBlocks = m_checkpointBlocks;
+		m_baseEpochs = m_checkpointEpochs;
+		m_baseRates = m_checkpointRates;
+	}
+}
+
+void RecordingStream::finish(StateManager &state)
+{
+	if (!active())
+	{
+		return;
+	}
+	std::vector<FileBlock> index;
+	state.m_samples.finishStream(index);
+	// Blocks are aligned, the tail isn't, so it starts straight after the last block.
+	BufferWriter tail;
+	writeTail(tail, Metadata(state), m_file->queued(), index);
+	m_tail.swap(tail.m_data);
+	m_file->append(&m_tail[0], m_tail.size());
+	m_end = m_file->queued();
+	m_finished = true;
+}
+
+bool RecordingStream::done() const
+{
+	return m_finished && m_file->written() >= m_end;
+}
+
+RecordingCheck::RecordingCheck() : m_busy(false), m_cancel(false), m_blocks(0), m_checked(0)
+{
+}
+
+RecordingCheck::~RecordingCheck()
+{
+	cancel();
+}
+
+void RecordingCheck::start(const std::string &filename)
+{
+	cancel();
+	m_filename = filename;
+	m_error.clear();
+	m_damaged.clear();
+	m_blocks = 0;
+	m_checked = 0;
+	m_cancel = false;
+	m_busy = true;
+	m_thread = std::thread(&RecordingCheck::run, this);
+}
+
+void RecordingCheck::cancel()
+{
+	m_cancel = true;
+	if (m_thread.joinable())
+	{
+		m_thread.join();
+	}
+}
+
+void RecordingCheck::run()
+{
+	MappedFile file;
+	std::vector<FileBlock> index;
+	Metadata metadata;
+	bool unfinished;
+	if (!file.open(m_filename))
+	{
+		m_error = "Can't open " + m_filename;
+	}
+	else if (readRecording(file, m_filename, index, metadata, unfinished, m_error))
+	{
+		m_blocks = (unsigned int)index.size();
+		// Blocks are handed out one at a time, at around 100KB each that costs nothing.
+		std::atomic<unsigned int> next(0);
+		std::mutex mutex;
+		std::vector<std::thread> workers(std::max(1u, std::thread::hardware_concurrency()));
+		for (size_t i = 0; i < workers.size(); ++i)
+		{
+			workers[i] = std::thread([&]
+			{
+				for (unsigned int b = next++; b < index.size() && !m_cancel; b = next++)
+				{
+					if (crc32c(file.data() + index[b].offset, index[b].bytes) != index[b].crc)
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						m_damaged.push_back(b);
+					}
+					m_checked++;
+				}
+			});
+		}
+		for (size_t i = 0; i < workers.size(); ++i)
+		{
+			workers[i].join();
+		}
+		std::sort(m_damaged.begin(), m_damaged.end());
+	}
+	m_busy = false;
+}
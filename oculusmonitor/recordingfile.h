@@ -0,0 +1,136 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#pragma once
+#include "spillfile.h"
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class StateManager;
+
+// Native recording files (.omr), holding everything a recording needs to be played back or exported again later.
+// Opening maps the file rather than reading it, sample blocks are only paged in as they are used.
+// On failure error says why.
+bool saveRecording(const std::string &filename, const StateManager &state, std::string &error);
+// Replaces the recording held by state. A streamed file that was never finished (the program or machine stopped
+// while recording) is recovered as far as it was written, and recovered is set.
+bool openRecording(const std::string &filename, StateManager &state, std::string &error, bool *recovered = 0);
+
+// Writes a recording to a .omr file while it's being made. Full sample blocks are written by a background thread as
+// they fill (see SampleStore::streamTo), so a recording isn't limited by memory and stopping doesn't have to write it
+// all out. Nothing here waits for the disk.
+// The file is append only, with a checkpoint every few blocks, so if finish() never happens it can still be
+// opened with everything up to the last few blocks written (see recordingfile.cpp).
+class RecordingStream
+{
+public:
+	RecordingStream();
+
+	// Start streaming state's recording, which should be empty.
+	bool open(const std::string &filename, StateManager &state, std::string &error);
+	// Call regularly while recording, appends a checkpoint when one is due.
+	void update(const StateManager &state);
+	// Queue the rest of the recording, its metadata and index. The file is complete once done().
+	void finish(StateManager &state);
+	// Between open() and finish().
+	bool active() const
+	{
+		return m_file && !m_finished;
+	}
+	bool done() const;
+	bool failed() const
+	{
+		return m_file && m_file->failed();
+	}
+	const std::string &filename() const
+	{
+		return m_filename;
+	}
+	// Null if nothing has been opened.
+	const SpillFile *file() const
+	{
+		return m_file.get();
+	}
+
+protected:
+	struct Checkpoint
+	{
+		std::vector<unsigned char> data;
+		long long end;
+	};
+
+	// Append a checkpoint covering the queued blocks up to blocks.
+	void checkpoint(const StateManager &state, unsigned int blocks);
+
+	std::shared_ptr<SpillFile> m_file;
+	std::vector<unsigned char> m_header;
+	std::vector<unsigned char> m_tail;		// Metadata, index and footer
+	long long m_end;
+	bool m_finished;
+	std::string m_filename;
+	std::deque<Checkpoint> m_checkpoints;	// Until written
+	unsigned long long m_base;				// Offset of the last full checkpoint, 0 if none yet
+	unsigned int m_baseBlocks;				// Blocks, epochs and rate segments it covers
+	unsigned int m_baseEpochs;
+	unsigned int m_baseRates;
+	unsigned int m_checkpointBlocks;		// Blocks, epochs and rate segments covered by checkpoints so far
+	unsigned int m_checkpointEpochs;
+	unsigned int m_checkpointRates;
+};
+
+// Checks the sample blocks of a recording file against their checksums, spread over all cores. Runs on a thread of
+// its own, so the recording can be used meanwhile. Opening only checks the metadata and index, which are small.
+class RecordingCheck
+{
+public:
+	RecordingCheck();
+	~RecordingCheck();
+
+	void start(const std::string &filename);
+	// Stops a check early and waits for it.
+	void cancel();
+	bool busy() const
+	{
+		return m_busy;
+	}
+	// Blocks in the file, 0 until its index has been read, and how many of them have been checked so far.
+	unsigned int blocks() const
+	{
+		return m_blocks;
+	}
+	unsigned int checked() const
+	{
+		return m_checked;
+	}
+	// Once it isn't busy: why the file couldn't be checked, or empty if it was.
+	const std::string &error() const
+	{
+		return m_error;
+	}
+	// Once it isn't busy: blocks whose checksums don't match, in order.
+	const std::vector<unsigned int> &damaged() const
+	{
+		return m_damaged;
+	}
+
+protected:
+	void run();
+
+	std::thread m_thread;
+	std::string m_filename;
+	std::string m_error;
+	std::vector<unsigned int> m_damaged;
+	std::atomic<bool> m_busy;
+	std::atomic<bool> m_cancel;
+	std::atomic<unsigned int> m_blocks;
+	std::atomic<unsigned int> m_checked;
+};
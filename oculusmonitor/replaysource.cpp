@@ -0,0 +1,59 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#include "replaysource.h"
+#include <thread>
+#include <cstring>
+
+ReplaySource::ReplaySource(const SampleStore &samples, const std::vector<DeviceEpoch> &epochs, bool realtime) : m_samples(samples), m_epochs(epochs), m_realtime(realtime), m_next(0), m_epoch(-1)
+{
+}
+
+void ReplaySource::begin()
+{
+	m_next = 0;
+	m_epoch = -1;
+	m_start = std::chrono::steady_clock::now();
+}
+
+bool ReplaySource::sample(VRState &state)
+{
+	if (m_next >= m_samples.size())
+	{
+		return false;
+	}
+	m_samples.get(m_next, state);
+	if (m_realtime)
+	{
+		std::chrono::duration<double> offset(state.time - m_samples.time(0));
+		std::this_thread::sleep_until(m_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset));
+	}
+	m_next++;
+	return true;
+}
+
+bool ReplaySource::pollDeviceInfo(DeviceInfo &info, double /*now*/)
+{
+	// Hand over the recorded device info as the replay reaches each epoch.
+	int epoch = findEpoch(m_epochs, m_next);
+	if (epoch < 0 || epoch == m_epoch)
+	{
+		return false;
+	}
+	unsigned int version = info.version;
+	info = *m_epochs[epoch].info;
+	info.version = version;
+	m_epoch = epoch;
+	return true;
+}
+
+bool ReplaySource::paced() const
+{
+	// Either self-timed from the recording, or as fast as possible.
+	return false;
+}
@@ -0,0 +1,32 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#pragma once
+#include "devicesource.h"
+#include <chrono>
+
+// Feeds a recording back through the sampler.
+// In real time mode samples are released at their recorded times, otherwise as fast as the consumer takes them.
+class ReplaySource : public DeviceSource
+{
+public:
+	ReplaySource(const SampleStore &samples, const std::vector<DeviceEpoch> &epochs, bool realtime);
+
+	virtual void begin();
+	virtual bool sample(VRState &state);
+	virtual bool pollDeviceInfo(DeviceInfo &info, double now);
+	virtual bool paced() const;
+
+protected:
+	SampleStore m_samples;		// Own copy, the recording may be replaced while replaying
+	std::vector<DeviceEpoch> m_epochs;
+	bool m_realtime;
+	unsigned int m_next;
+	int m_epoch;				// Index of the last epoch handed to the sampler
+	std::chrono::steady_clock::time_point m_start;
+};
@@ -0,0 +1,341 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#include "sampler.h"
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <mmsystem.h>
+#pragma comment(lib,"winmm.lib")
+#endif
+
+namespace
+{
+	// How long everything has to stay below the lower threshold before dropping to the idle rate.
+	const double c_idleHoldTime = 1.0;
+	// Device info versions kept for samples that are still queued when the info changes.
+	const size_t c_epochHistory = 16;
+
+	void accumulateMotion(const ovrPoseStatef &pose, float &linear, float &angular)
+	{
+		linear = std::max(linear, OVR::Vector3f(pose.LinearVelocity).Length());
+		angular = std::max(angular, OVR::Vector3f(pose.AngularVelocity).Length());
+	}
+}
+
+Sampler::Sampler() : m_source(0), m_running(false), m_finished(false), m_rate(500.0), m_achievedRate(0.0), m_dropped(0), m_queue(4096), m_adaptive(false), m_idleRate(90.0), m_linearThreshold(0.05f), m_angularThreshold(0.2f), m_currentRate(500.0), m_moving(true), m_lastMotion(0), m_infoVersion(0), m_lastPose()
+{
+}
+
+Sampler::~Sampler()
+{
+	stop();
+}
+
+void Sampler::start(DeviceSource *source, double rateHz)
+{
+	stop();
+	m_source = source;
+	// Start from a clean slate for the new source, but keep the version counting up so the UI notices.
+	unsigned int version = m_workInfo.version;
+	m_workInfo = DeviceInfo();
+	m_workInfo.version = version;
+	m_rate = rateHz;
+	m_currentRate = rateHz;
+	m_moving = true;
+	m_lastMotion = 0;
+	m_dropped = 0;
+	m_finished = false;
+	m_running = true;
+#ifdef _WIN32
+	// Default scheduler granularity is ~15ms, far too coarse for kHz polling.
+	timeBeginPeriod(1);
+#endif
+	m_thread = std::thread(&Sampler::run, this);
+}
+
+void Sampler::stop()
+{
+	if (m_thread.joinable())
+	{
+		m_running = false;
+		m_thread.join();
+#ifdef _WIN32
+		timeEndPeriod(1);
+#endif
+	}
+}
+
+bool Sampler::running() const
+{
+	return m_running;
+}
+
+bool Sampler::finished() const
+{
+	return m_finished;
+}
+
+void Sampler::setRate(double rateHz)
+{
+	m_rate = rateHz;
+}
+
+double Sampler::rate() const
+{
+	return m_rate;
+}
+
+bool Sampler::pop(VRState &state)
+{
+	return m_queue.pop(state);
+}
+
+double Sampler::achievedRate() const
+{
+	return m_achievedRate;
+}
+
+unsigned int Sampler::dropped() const
+{
+	return m_dropped;
+}
+
+bool Sampler::deviceInfo(DeviceInfo &info)
+{
+	if (info.version == m_infoVersion)
+	{
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(m_infoMutex);
+	info = m_info;
+	return true;
+}
+
+std::shared_ptr<const DeviceInfo> Sampler::epoch(unsigned int version)
+{
+	std::lock_guard<std::mutex> lock(m_infoMutex);
+	for (size_t i = m_epochs.size(); i > 0; --i)
+	{
+		if (m_epochs[i - 1]->version == version)
+		{
+			return m_epochs[i - 1];
+		}
+	}
+	return std::shared_ptr<const DeviceInfo>();
+}
+
+void Sampler::setAdaptive(bool enabled, double idleRateHz, float linearThreshold, float angularThreshold)
+{
+	m_idleRate = idleRateHz;
+	m_linearThreshold = linearThreshold;
+	m_angularThreshold = angularThreshold;
+	m_adaptive = enabled;
+}
+
+double Sampler::currentRate() const
+{
+	return m_currentRate;
+}
+
+LatencyStats &Sampler::latency()
+{
+	return m_latency;
+}
+
+double Sampler::adaptRate(const VRState &state, double now)
+{
+	if (!m_adaptive)
+	{
+		m_moving = true;
+		return m_rate;
+	}
+
+	float linear = 0;
+	float angular = 0;
+	accumulateMotion(state.trackingState.HeadPose, linear, angular);
+	for (int i = 0; i < 2; ++i)
+	{
+		if (state.trackingState.HandStatusFlags[i] & (ovrStatus_OrientationTracked | ovrStatus_PositionTracked))
+		{
+			accumulateMotion(state.trackingState.HandPoses[i], linear, angular);
+		}
+	}
+	for (int i = 0; i < 4; ++i)
+	{
+		if (state.objectFlags & (1 << i))
+		{
+			accumulateMotion(state.objectPoses[i], linear, angular);
+		}
+	}
+
+	// Hysteresis: speed up as soon as anything crosses the threshold, but only slow down again
+	// once everything has stayed below half the threshold for the hold time.
+	float linearThreshold = m_linearThreshold;
+	float angularThreshold = m_angularThreshold;
+	if (linear > linearThreshold || angular > angularThreshold)
+	{
+		m_moving = true;
+		m_lastMotion = now;
+	}
+	else if (linear > linearThreshold * 0.5f || angular > angularThreshold * 0.5f)
+	{
+		if (m_moving)
+		{
+			m_lastMotion = now;
+		}
+	}
+	else if (m_moving && now - m_lastMotion > c_idleHoldTime)
+	{
+		m_moving = false;
+	}
+	return m_moving ? m_rate : m_idleRate;
+}
+
+unsigned int Sampler::freshFlags(const VRState &state)
+{
+	// Compare everything but the timestamp. A device that hasn't updated since the last poll returns a bit identical pose.
+	const size_t poseBytes = offsetof(ovrPoseStatef, LinearAcceleration) + sizeof(ovrVector3f);
+	unsigned int flags = 0;
+	for (int i = 0; i < e_deviceCount; ++i)
+	{
+		const ovrPoseStatef &pose = devicePose(state, i);
+		if (memcmp(&pose, &m_lastPose[i], poseBytes) != 0)
+		{
+			flags |= 1 << i;
+			m_lastPose[i] = pose;
+		}
+	}
+	return flags;
+}
+
+void Sampler::run()
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+	Clock::time_point next = start;
+	Clock::time_point rateStart = start;
+	unsigned int rateCount = 0;
+
+	m_source->setLatency(&m_latency);
+	m_source->begin();
+	while (m_running)
+	{
+		Clock::time_point now = Clock::now();
+		double seconds = std::chrono::duration<double>(now - start).count();
+		m_latency.beginSample();
+		if (m_source->pollDeviceInfo(m_workInfo, seconds))
+		{
+			std::lock_guard<std::mutex> lock(m_infoMutex);
+			m_workInfo.version++;
+			m_info = m_workInfo;
+			m_infoVersion = m_info.version;
+			// Samples still queued may refer to older versions, keep a few around for the consumer.
+			if (m_epochs.size() >= c_epochHistory)
+			{
+				m_epochs.erase(m_epochs.begin());
+			}
+			m_epochs.push_back(std::make_shared<DeviceInfo>(m_workInfo));
+		}
+
+		VRState state;
+		memset(state.latency, 0, sizeof(state.latency));
+		// How late this iteration started compared to when it was scheduled.
+		float lateness = std::chrono::duration<float, std::micro>(now - next).count();
+		bool sampled;
+		{
+			LatencyTimer timer(&m_latency, e_latencySample);
+			sampled = m_source->sample(state);
+		}
+		if (!sampled)
+		{
+			m_finished = true;
+			break;
+		}
+		bool paced = m_source->paced();
+		double rate = m_currentRate;
+		state.freshFlags = freshFlags(state);
+		state.wallTime = seconds;
+		state.epoch = m_workInfo.version;
+		if (paced)
+		{
+			state.lateness = std::max(lateness, 0.0f);
+		}
+		m_latency.record(e_latencyPoll, Clock::now() - now);
+		// Keep any latencies a replayed sample carries for calls that weren't made this time.
+		const float *latency = m_latency.current();
+		for (int i = 0; i < e_latencyCount; ++i)
+		{
+			if (latency[i] > 0)
+			{
+				state.latency[i] = latency[i];
+			}
+		}
+		if (paced)
+		{
+			state.sampleRate = (float)rate;
+			rate = adaptRate(state, seconds);
+			m_currentRate = rate;
+			if (!m_queue.push(state))
+			{
+				m_dropped++;
+			}
+		}
+		else
+		{
+			// Unpaced sources produce samples faster than real time, so wait for the consumer rather than dropping.
+			while (!m_queue.push(state) && m_running)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		rateCount++;
+		double rateElapsed = std::chrono::duration<double>(now - rateStart).count();
+		if (rateElapsed >= 1.0)
+		{
+			m_achievedRate = rateCount / rateElapsed;
+			rateCount = 0;
+			rateStart = now;
+		}
+
+		if (!paced)
+		{
+			continue;
+		}
+		next += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+		if (next < now)
+		{
+			// Fell behind (debugger, system stall). Don't try to catch up with a burst of samples.
+			next = now;
+		}
+
+		// Sleep for most of the interval, then spin the rest since OS sleeps overshoot by up to a millisecond.
+		while (true)
+		{
+			Clock::duration remaining = next - Clock::now();
+			if (remaining <= Clock::duration::zero())
+			{
+				break;
+			}
+			if (remaining > std::chrono::milliseconds(2))
+			{
+				std::this_thread::sleep_for(remaining - std::chrono::milliseconds(2));
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+}
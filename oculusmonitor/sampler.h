@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#pragma once
+#include "vrstate.h"
+#include "devicesource.h"
+#include "spscqueue.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// Polls a DeviceSource on its own thread at a fixed rate, independent of the UI frame rate.
+// Samples are handed to the consumer (the UI thread) through a lock free queue.
+class Sampler
+{
+public:
+	Sampler();
+	~Sampler();
+
+	// The source must outlive the sampler (or the next stop()).
+	void start(DeviceSource *source, double rateHz);
+	void stop();
+	bool running() const;
+	// True once the source has run out of samples (end of a replay or synthetic run).
+	bool finished() const;
+
+	void setRate(double rateHz);
+	double rate() const;
+
+	// Consumer side, call from a single thread.
+	bool pop(VRState &state);
+
+	// Samples per second actually achieved over the last second.
+	double achievedRate() const;
+	// Samples thrown away because the consumer didn't keep up.
+	unsigned int dropped() const;
+
+	// Copies the latest device info if it has changed since info.version. Returns true if it was updated.
+	bool deviceInfo(DeviceInfo &info);
+	// The device info a sample was taken under (VRState::epoch), or null if it's no longer kept.
+	std::shared_ptr<const DeviceInfo> epoch(unsigned int version);
+	// Motion adaptive rate. When enabled the sampler drops to the idle rate while the head, hands and objects
+	// are still, and returns to the normal rate as soon as any of them moves faster than the thresholds.
+	void setAdaptive(bool enabled, double idleRateHz, float linearThreshold, float angularThreshold);
+	// The rate currently in effect (the normal rate, or the idle rate while adaptive and idle).
+	double currentRate() const;
+	// Time spent in each call on the sampling path. Histograms may be read from any thread.
+	LatencyStats &latency();
+
+protected:
+	void run();
+	double adaptRate(const VRState &state, double now);
+	unsigned int freshFlags(const VRState &state);
+
+	DeviceSource *m_source;
+	std::thread m_thread;
+	std::atomic<bool> m_running;
+	std::atomic<bool> m_finished;
+	std::atomic<double> m_rate;
+	std::atomic<double> m_achievedRate;
+	std::atomic<unsigned int> m_dropped;
+	SPSCQueue<VRState> m_queue;
+	LatencyStats m_latency;
+
+	std::atomic<bool> m_adaptive;
+	std::atomic<double> m_idleRate;
+	std::atomic<float> m_linearThreshold;	// m/s
+	std::atomic<float> m_angularThreshold;	// rad/s
+	std::atomic<double> m_currentRate;
+	bool m_moving;
+	double m_lastMotion;
+
+	DeviceInfo m_workInfo;			// Sampler thread's copy, updated by the source
+	DeviceInfo m_info;				// Published copy, written only by the sampler thread under m_infoMutex
+	std::mutex m_infoMutex;
+	std::atomic<unsigned int> m_infoVersion;
+	std::vector<std::shared_ptr<const DeviceInfo>> m_epochs;	// Recently published infos under m_infoMutex, oldest first
+	ovrPoseStatef m_lastPose[e_deviceCount];
+};
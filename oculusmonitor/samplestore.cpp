@@ -0,0 +1,1706 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#include "vrstate.h"
+#include "mappedfile.h"
+#include "crc32c.h"
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <thread>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace
+{
+	const size_t c_blockAlignment = 64;
+
+	void *alignedAlloc(size_t size)
+	{
+#ifdef _WIN32
+		void *memory = _aligned_malloc(size, c_blockAlignment);
+#else
+		void *memory = 0;
+		if (posix_memalign(&memory, c_blockAlignment, size) != 0)
+		{
+			memory = 0;
+		}
+#endif
+		if (!memory)
+		{
+			throw std::bad_alloc();
+		}
+		return memory;
+	}
+
+	void alignedFree(void *memory)
+	{
+#ifdef _WIN32
+		_aligned_free(memory);
+#else
+		free(memory);
+#endif
+	}
+
+	// How a column is packed.
+	// The byte codecs turn a column into a stream of integers (one or more per sample) stored as variable length,
+	// with runs of zeros collapsed, so anything that doesn't change between samples costs next to nothing.
+	// The bit codecs are for lossless packing, where floats have to be kept bit for bit.
+	enum Codec
+	{
+		e_codecBits,		// 32 bit words, xor with the previous sample. Lossless
+		e_codecFloat,		// Floats as fixed point multiples of step
+		e_codecDouble,		// Doubles as fixed point multiples of step
+		e_codecQuat,		// Smallest three, delta against the previous sample
+		e_codecXor,			// Floats xor the previous value, only the changed bits are stored (as in Facebook's Gorilla)
+		e_codecTimestamp	// Doubles as delta of delta of their bit patterns, small while the interval is steady
+	};
+
+	const double c_timeStep = 1e-9;				// Timestamps to the nanosecond
+	const double c_analogStep = 1.0 / 65536.0;	// Thumbsticks and triggers
+	const double c_quatScale = 65536.0;			// Smallest three components, about 0.002 degrees
+	const long long c_quatZero = 1ll << 40;		// First part of a zero quaternion, a unit one's are at most 1/sqrt(2)
+
+	// Where each column comes from in a VRState, where its array sits in a block, and how it's packed.
+	struct ColumnLayout
+	{
+		size_t source[e_columnCount];
+		size_t size[e_columnCount];
+		size_t offset[e_columnCount];
+		Codec codec[e_columnCount];		// Quantized packing
+		Codec lossless[e_columnCount];	// Lossless packing
+		double step[e_columnCount];		// Fixed point step, 0 for the position step chosen by setCompression()
+		bool delta[e_columnCount];		// Fixed point values are stored as the change from the previous sample
+		size_t blockBytes;
+
+		ColumnLayout()
+		{
+			set(e_columnTime, offsetof(VRState, time), sizeof(double), e_codecDouble, c_timeStep);
+			set(e_columnRuntimeTime, offsetof(VRState, runtimeTime), sizeof(double), e_codecDouble, c_timeStep);
+			set(e_columnWallTime, offsetof(VRState, wallTime), sizeof(double), e_codecDouble, c_timeStep);
+			set(e_columnSampleRate, offsetof(VRState, sampleRate), sizeof(float), e_codecBits);
+			set(e_columnEpoch, offsetof(VRState, epoch), sizeof(unsigned int), e_codecBits);
+			set(e_columnLateness, offsetof(VRState, lateness), sizeof(float), e_codecFloat, 0.01, false);
+			// Calls that weren't made are 0, so the values themselves pack better than their changes.
+			set(e_columnLatency, offsetof(VRState, latency), sizeof(VRState::latency), e_codecFloat, 0.1, false);
+			set(e_columnThumbStick, offsetof(VRState, touchThumbStick), sizeof(VRState::touchThumbStick), e_codecFloat, c_analogStep);
+			set(e_columnThumbStickNDZ, offsetof(VRState, touchThumbStickNDZ), sizeof(VRState::touchThumbStickNDZ), e_codecFloat, c_analogStep);
+			set(e_columnThumbStickRaw, offsetof(VRState, touchThumbStickRaw), sizeof(VRState::touchThumbStickRaw), e_codecFloat, c_analogStep);
+			set(e_columnHandTrigger, offsetof(VRState, touchHandTrigger), sizeof(VRState::touchHandTrigger), e_codecFloat, c_analogStep);
+			set(e_columnHandTriggerNDZ, offsetof(VRState, touchHandTriggerNDZ), sizeof(VRState::touchHandTriggerNDZ), e_codecFloat, c_analogStep);
+			set(e_columnHandTriggerRaw, offsetof(VRState, touchHandTriggerRaw), sizeof(VRState::touchHandTriggerRaw), e_codecFloat, c_analogStep);
+			set(e_columnIndexTrigger, offsetof(VRState, touchIndexTrigger), sizeof(VRState::touchIndexTrigger), e_codecFloat, c_analogStep);
+			set(e_columnIndexTriggerNDZ, offsetof(VRState, touchIndexTriggerNDZ), sizeof(VRState::touchIndexTriggerNDZ), e_codecFloat, c_analogStep);
+			set(e_columnIndexTriggerRaw, offsetof(VRState, touchIndexTriggerRaw), sizeof(VRState::touchIndexTriggerRaw), e_codecFloat, c_analogStep);
+			size_t tracking = offsetof(VRState, trackingState);
+			set(e_columnStatusFlags, tracking + offsetof(ovrTrackingState, StatusFlags), sizeof(unsigned int), e_codecBits);
+			set(e_columnHandStatusFlags, tracking + offsetof(ovrTrackingState, HandStatusFlags), sizeof(ovrTrackingState::HandStatusFlags), e_codecBits);
+			set(e_columnCalibratedOrigin, tracking + offsetof(ovrTrackingState, CalibratedOrigin), sizeof(ovrPosef), e_codecBits);
+			set(e_columnObjectFlags, offsetof(VRState, objectFlags), sizeof(unsigned int), e_codecBits);
+			set(e_columnFreshFlags, offsetof(VRState, freshFlags), sizeof(unsigned int), e_codecBits);
+			set(e_columnSensorCount, offsetof(VRState, sensorCount), sizeof(unsigned int), e_codecBits);
+			// Sensors are polled slowly, so these rarely change and pack to almost nothing losslessly.
+			set(e_columnSensorPose, offsetof(VRState, sensorPose), sizeof(VRState::sensorPose), e_codecBits);
+			for (int device = 0; device < e_deviceCount; ++device)
+			{
+				size_t pose;
+				switch (device)
+				{
+				case e_deviceHead:
+					pose = tracking + offsetof(ovrTrackingState, HeadPose);
+					break;
+				case e_deviceLeftTouch:
+					pose = tracking + offsetof(ovrTrackingState, HandPoses);
+					break;
+				case e_deviceRightTouch:
+					pose = tracking + offsetof(ovrTrackingState, HandPoses) + sizeof(ovrPoseStatef);
+					break;
+				default:
+					pose = offsetof(VRState, objectPoses) + (device - e_deviceObject0) * sizeof(ovrPoseStatef);
+					break;
+				}
+				set(SampleStore::poseColumn(device, e_poseOrientation), pose + offsetof(ovrPoseStatef, ThePose) + offsetof(ovrPosef, Orientation), sizeof(ovrQuatf), e_codecQuat);
+				set(SampleStore::poseColumn(device, e_posePosition), pose + offsetof(ovrPoseStatef, ThePose) + offsetof(ovrPosef, Position), sizeof(ovrVector3f), e_codecFloat, 0);
+				set(SampleStore::poseColumn(device, e_poseAngularVelocity), pose + offsetof(ovrPoseStatef, AngularVelocity), sizeof(ovrVector3f), e_codecFloat, 1e-4);
+				set(SampleStore::poseColumn(device, e_poseLinearVelocity), pose + offsetof(ovrPoseStatef, LinearVelocity), sizeof(ovrVector3f), e_codecFloat, 1e-4);
+				set(SampleStore::poseColumn(device, e_poseAngularAcceleration), pose + offsetof(ovrPoseStatef, AngularAcceleration), sizeof(ovrVector3f), e_codecFloat, 1e-3);
+				set(SampleStore::poseColumn(device, e_poseLinearAcceleration), pose + offsetof(ovrPoseStatef, LinearAcceleration), sizeof(ovrVector3f), e_codecFloat, 1e-3);
+				set(SampleStore::poseColumn(device, e_poseTime), pose + offsetof(ovrPoseStatef, TimeInSeconds), sizeof(double), e_codecDouble, c_timeStep);
+			}
+
+			for (int i = 0; i < e_columnCount; ++i)
+			{
+				lossless[i] = codec[i] == e_codecDouble ? e_codecTimestamp : codec[i] == e_codecBits ? e_codecBits : e_codecXor;
+			}
+
+			// Each column starts on a cache line.
+			blockBytes = 0;
+			for (int i = 0; i < e_columnCount; ++i)
+			{
+				offset[i] = blockBytes;
+				blockBytes += (size[i] * SampleStore::c_blockSamples + c_blockAlignment - 1) & ~(c_blockAlignment - 1);
+			}
+		}
+
+		void set(int column, size_t from, size_t bytes, Codec packing, double fixedStep = 0, bool deltas = true)
+		{
+			source[column] = from;
+			size[column] = bytes;
+			codec[column] = packing;
+			step[column] = fixedStep;
+			delta[column] = deltas;
+		}
+	};
+
+	const ColumnLayout &layout()
+	{
+		static ColumnLayout s_layout;
+		return s_layout;
+	}
+
+	unsigned long long zigzag(long long value)
+	{
+		return ((unsigned long long)value << 1) ^ (unsigned long long)(value >> 63);
+	}
+
+	long long unzigzag(unsigned long long value)
+	{
+		return (long long)(value >> 1) ^ -(long long)(value & 1);
+	}
+
+	const long long c_maxQuantized = 4000000000000000000ll;
+
+	// Adds a decoded change to a quantized value, false if that's beyond anything quantize() gives.
+	bool addDelta(long long &value, long long delta)
+	{
+		if ((delta > 0 && value > c_maxQuantized - delta) || (delta < 0 && value < -c_maxQuantized - delta))
+		{
+			return false;
+		}
+		value += delta;
+		return true;
+	}
+
+	long long quantize(double value, double step)
+	{
+		double q = value / step;
+		// Keep NaN and anything absurdly large from overflowing, they aren't meaningful tracking data anyway.
+		if (!(q > -c_maxQuantized && q < c_maxQuantized))
+		{
+			return 0;
+		}
+		return (long long)std::floor(q + 0.5);
+	}
+
+	// Stream of unsigned integers, 7 bits per byte. A 0 is followed by the number of further zeros.
+	class PackWriter
+	{
+	public:
+		PackWriter(std::vector<unsigned char> &out) : m_out(out), m_zeros(0)
+		{
+		}
+
+		void put(unsigned long long value)
+		{
+			if (value == 0)
+			{
+				m_zeros++;
+				return;
+			}
+			flush();
+			write(value);
+		}
+
+		void flush()
+		{
+			if (m_zeros)
+			{
+				write(0);
+				write(m_zeros - 1);
+				m_zeros = 0;
+			}
+		}
+
+	protected:
+		void write(unsigned long long value)
+		{
+			while (value >= 0x80)
+			{
+				m_out.push_back((unsigned char)(value | 0x80));
+				value >>= 7;
+			}
+			m_out.push_back((unsigned char)value);
+		}
+
+		std::vector<unsigned char> &m_out;
+		unsigned long long m_zeros;
+	};
+
+	// Reads no further than end. A stream that runs out or holds a value too big for 64 bits has failed(), and
+	// gives zeros from then on.
+	class PackReader
+	{
+	public:
+		PackReader(const unsigned char *in, const unsigned char *end) : m_in(in), m_end(end), m_zeros(0), m_failed(false)
+		{
+		}
+
+		bool failed() const
+		{
+			return m_failed;
+		}
+
+		// Also fails the stream, for values that can't be right.
+		void fail()
+		{
+			m_failed = true;
+			m_in = m_end;
+		}
+
+		unsigned long long get()
+		{
+			if (m_zeros)
+			{
+				m_zeros--;
+				return 0;
+			}
+			unsigned long long value = read();
+			if (value == 0)
+			{
+				m_zeros = read();
+			}
+			return value;
+		}
+
+	protected:
+		unsigned long long read()
+		{
+			// Most values are a single byte. Longer ones are at most 10.
+			if (m_in != m_end && *m_in < 0x80)
+			{
+				return *m_in++;
+			}
+			const unsigned char *limit = m_end - m_in > 10 ? m_in + 10 : m_end;
+			unsigned long long value = 0;
+			int shift = 0;
+			unsigned char byte;
+			do
+			{
+				if (m_in == limit)
+				{
+					fail();
+					return 0;
+				}
+				byte = *m_in++;
+				value |= (unsigned long long)(byte & 0x7f) << shift;
+				shift += 7;
+			} while (byte & 0x80);
+			return value;
+		}
+
+		const unsigned char *m_in;
+		const unsigned char *m_end;
+		unsigned long long m_zeros;
+		bool m_failed;
+	};
+
+	// Bits packed from the lowest bit of each byte up.
+	class BitWriter
+	{
+	public:
+		BitWriter(std::vector<unsigned char> &out) : m_out(out), m_bits(0), m_count(0)
+		{
+		}
+
+		// Up to 32 bits at a time.
+		void put(unsigned int value, int bits)
+		{
+			m_bits |= (unsigned long long)(value & (unsigned int)((1ull << bits) - 1)) << m_count;
+			m_count += bits;
+			while (m_count >= 8)
+			{
+				m_out.push_back((unsigned char)m_bits);
+				m_bits >>= 8;
+				m_count -= 8;
+			}
+		}
+
+		void put64(unsigned long long value)
+		{
+			put((unsigned int)value, 32);
+			put((unsigned int)(value >> 32), 32);
+		}
+
+		void flush()
+		{
+			if (m_count)
+			{
+				m_out.push_back((unsigned char)m_bits);
+				m_bits = 0;
+				m_count = 0;
+			}
+		}
+
+	protected:
+		std::vector<unsigned char> &m_out;
+		unsigned long long m_bits;
+		int m_count;
+	};
+
+	// Reads no further than end, as zeros once it has failed().
+	class BitReader
+	{
+	public:
+		BitReader(const unsigned char *in, const unsigned char *end) : m_in(in), m_end(end), m_bits(0), m_count(0), m_failed(false)
+		{
+		}
+
+		bool failed() const
+		{
+			return m_failed;
+		}
+
+		// Also fails the stream, for values that can't be right.
+		void fail()
+		{
+			m_failed = true;
+		}
+
+		unsigned int get(int bits)
+		{
+			while (m_count < bits)
+			{
+				if (m_in == m_end)
+				{
+					m_failed = true;
+					return 0;
+				}
+				m_bits |= (unsigned long long)*m_in++ << m_count;
+				m_count += 8;
+			}
+			unsigned int value = (unsigned int)(m_bits & ((1ull << bits) - 1));
+			m_bits >>= bits;
+			m_count -= bits;
+			return value;
+		}
+
+		unsigned long long get64()
+		{
+			unsigned long long low = get(32);
+			return low | (unsigned long long)get(32) << 32;
+		}
+
+	protected:
+		const unsigned char *m_in;
+		const unsigned char *m_end;
+		unsigned long long m_bits;
+		int m_count;
+		bool m_failed;
+	};
+
+	int leadingZeros(unsigned int value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse(&index, value);
+		return 31 - (int)index;
+#else
+		return __builtin_clz(value);
+#endif
+	}
+
+	int trailingZeros(unsigned int value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, value);
+		return (int)index;
+#else
+		return __builtin_ctz(value);
+#endif
+	}
+
+	// One component of a float column (every count'th word), each value xor the previous.
+	// 0: unchanged. 10: the changed bits fit in the previous window, just those bits follow.
+	// 11: 5 bits of leading zeros, 5 bits of length - 1, then that many bits.
+	void packXor(BitWriter &out, const unsigned int *words, size_t count)
+	{
+		unsigned int previous = 0;
+		int leading = -1;
+		int trailing = 0;
+		for (size_t i = 0; i < SampleStore::c_blockSamples; ++i)
+		{
+			unsigned int value = words[i * count];
+			unsigned int x = value ^ previous;
+			previous = value;
+			if (!x)
+			{
+				out.put(0, 1);
+				continue;
+			}
+			int lz = leadingZeros(x);
+			int tz = trailingZeros(x);
+			if (leading >= 0 && lz >= leading && tz >= trailing)
+			{
+				out.put(1, 2);
+				out.put(x >> trailing, 32 - leading - trailing);
+			}
+			else
+			{
+				int length = 32 - lz - tz;
+				out.put(3, 2);
+				out.put(lz, 5);
+				out.put(length - 1, 5);
+				out.put(x >> tz, length);
+				leading = lz;
+				trailing = tz;
+			}
+		}
+	}
+
+	void unpackXor(BitReader &in, unsigned int *words, size_t count)
+	{
+		unsigned int previous = 0;
+		int leading = 0;
+		int trailing = 0;
+		for (size_t i = 0; i < SampleStore::c_blockSamples; ++i)
+		{
+			if (in.get(1))
+			{
+				if (in.get(1))
+				{
+					leading = in.get(5);
+					int length = in.get(5) + 1;
+					if (leading + length > 32)
+					{
+						in.fail();
+						return;
+					}
+					trailing = 32 - leading - length;
+				}
+				previous ^= in.get(32 - leading - trailing) << trailing;
+			}
+			words[i * count] = previous;
+		}
+	}
+
+	// Doubles as 64 bit patterns. Times taken at a steady rate have nearly constant differences, so the change in
+	// difference is usually tiny. 0: no change. 10, 110, 1110: 8, 16 or 32 bits follow. 1111: all 64 bits follow.
+	void packTimestamps(BitWriter &out, const unsigned long long *values)
+	{
+		unsigned long long previous = 0;
+		unsigned long long previousDelta = 0;
+		for (size_t i = 0; i < SampleStore::c_blockSamples; ++i)
+		{
+			unsigned long long delta = values[i] - previous;
+			unsigned long long z = zigzag((long long)(delta - previousDelta));
+			previous = values[i];
+			previousDelta = delta;
+			if (z == 0)
+			{
+				out.put(0, 1);
+			}
+			else if (z < 0x100)
+			{
+				out.put(1, 2);
+				out.put((unsigned int)z, 8);
+			}
+			else if (z < 0x10000)
+			{
+				out.put(3, 3);
+				out.put((unsigned int)z, 16);
+			}
+			else if (z < 0x100000000ull)
+			{
+				out.put(7, 4);
+				out.put((unsigned int)z, 32);
+			}
+			else
+			{
+				out.put(15, 4);
+				out.put64(z);
+			}
+		}
+	}
+
+	void unpackTimestamps(BitReader &in, unsigned long long *values)
+	{
+		unsigned long long previous = 0;
+		unsigned long long previousDelta = 0;
+		for (size_t i = 0; i < SampleStore::c_blockSamples; ++i)
+		{
+			unsigned long long z = 0;
+			if (in.get(1))
+			{
+				if (!in.get(1))
+					z = in.get(8);
+				else if (!in.get(1))
+					z = in.get(16);
+				else if (!in.get(1))
+					z = in.get(32);
+				else
+					z = in.get64();
+			}
+			previousDelta += (unsigned long long)unzigzag(z);
+			previous += previousDelta;
+			values[i] = previous;
+		}
+	}
+
+	// The three smallest components of a unit quaternion, and which one was dropped.
+	void smallestThree(const ovrQuatf &q, int &largest, long long parts[3])
+	{
+		const float c[4] = { q.x, q.y, q.z, q.w };
+		largest = 0;
+		for (int i = 1; i < 4; ++i)
+		{
+			if (std::fabs(c[i]) > std::fabs(c[largest]))
+				largest = i;
+		}
+		// Untracked devices report all zeros, which isn't a rotation and gets a code of its own.
+		if (c[largest] == 0)
+		{
+			parts[0] = c_quatZero;
+			parts[1] = parts[2] = 0;
+			return;
+		}
+		// q and -q are the same rotation, flip so the dropped component is positive.
+		float sign = c[largest] < 0 ? -1.0f : 1.0f;
+		for (int i = 0, j = 0; i < 4; ++i)
+		{
+			if (i != largest)
+				parts[j++] = quantize(c[i] * sign, 1.0 / c_quatScale);
+		}
+	}
+
+	ovrQuatf fromSmallestThree(int largest, const long long parts[3])
+	{
+		if (parts[0] == c_quatZero && parts[1] == 0 && parts[2] == 0)
+		{
+			ovrQuatf zero = {};
+			return zero;
+		}
+		float c[4];
+		double sum = 0;
+		for (int i = 0, j = 0; i < 4; ++i)
+		{
+			if (i != largest)
+			{
+				c[i] = (float)(parts[j++] / c_quatScale);
+				sum += c[i] * c[i];
+			}
+		}
+		c[largest] = (float)std::sqrt(std::max(0.0, 1.0 - sum));
+		ovrQuatf q = { c[0], c[1], c[2], c[3] };
+		return q;
+	}
+}
+
+const char g_blockRecordMagic[8] = { 'O', 'M', 'B', 'L', 'O', 'C', 'K', '1' };
+
+SampleStore::SampleStore() : m_size(0), m_capacity(0), m_discarded(0), m_compression(e_compressNone), m_positionStep(0.0002f), m_budget(0), m_spillQueued(0), m_spillFreed(0), m_streaming(false), m_stalls(0), m_cacheClock(0), m_lastEntry(0), m_readAheadBlock(-1), m_readAheadDirection(0)
+{
+	setCacheBudget(c_cacheBytes);
+}
+
+SampleStore::SampleStore(const SampleStore &other) : m_size(0), m_capacity(0), m_discarded(0), m_compression(e_compressNone), m_positionStep(0.0002f), m_budget(0), m_spillQueued(0), m_spillFreed(0), m_streaming(false), m_stalls(0), m_cacheClock(0), m_lastEntry(0), m_readAheadBlock(-1), m_readAheadDirection(0)
+{
+	setCacheBudget(c_cacheBytes);
+	*this = other;
+}
+
+SampleStore &SampleStore::operator=(const SampleStore &other)
+{
+	if (this == &other)
+	{
+		return *this;
+	}
+	clear();
+	m_blocks.resize(other.m_blocks.size());
+	for (size_t i = 0; i < other.m_blocks.size(); ++i)
+	{
+		m_blocks[i] = other.m_blocks[i];
+		if (other.m_blocks[i].raw)
+		{
+			m_blocks[i].raw = allocateBlock();
+			memcpy(m_blocks[i].raw, other.m_blocks[i].raw, layout().blockBytes);
+		}
+		// Blocks only on disk stay there, anything still in memory is copied and stays in memory.
+		if (m_blocks[i].raw || !m_blocks[i].packed.empty() || m_blocks[i].mapped)
+		{
+			m_blocks[i].spillOffset = -1;
+		}
+	}
+	m_spill = other.m_spill;
+	m_mapping = other.m_mapping;
+	m_size = other.m_size;
+	for (int i = 0; i < e_buttonFieldCount; ++i)
+	{
+		m_edges[i] = other.m_edges[i];
+		for (int bit = 0; bit < 32; ++bit)
+		{
+			m_bitEdges[i][bit] = other.m_bitEdges[i][bit];
+		}
+	}
+	return *this;
+}
+
+SampleStore::~SampleStore()
+{
+	clear();
+	releasePool();
+	for (size_t i = 0; i < m_cache.size(); ++i)
+	{
+		if (m_cache[i].raw)
+			alignedFree(m_cache[i].raw);
+	}
+}
+
+size_t SampleStore::columnOffset(int column)
+{
+	return layout().offset[column];
+}
+
+size_t SampleStore::columnSize(int column)
+{
+	return layout().size[column];
+}
+
+size_t SampleStore::maxBlockBytes()
+{
+	return 2 * layout().blockBytes;
+}
+
+unsigned char *SampleStore::allocateBlock()
+{
+	if (!m_pool.empty())
+	{
+		unsigned char *block = m_pool.back();
+		m_pool.pop_back();
+		return block;
+	}
+	return (unsigned char *)alignedAlloc(layout().blockBytes);
+}
+
+const unsigned char *SampleStore::columnData(unsigned int block, int column) const
+{
+	const Block &b = m_blocks[block];
+	if (b.raw)
+	{
+		return b.raw + layout().offset[column];
+	}
+	if (b.mapped && b.packing == e_compressNone && intact(b))
+	{
+		return b.mapped + layout().offset[column];
+	}
+
+	// Packed, find the block in the cache or replace the least recently used entry. Reads mostly stay in one
+	// block for a while, so the last entry used is tried first.
+	CacheEntry *entry = &m_cache[m_lastEntry];
+	if (entry->block != (int)block)
+	{
+		entry = &m_cache[0];
+		for (size_t i = 0; i < m_cache.size(); ++i)
+		{
+			if (m_cache[i].block == (int)block)
+			{
+				entry = &m_cache[i];
+				break;
+			}
+			if (m_cache[i].used < entry->used)
+			{
+				entry = &m_cache[i];
+			}
+		}
+		m_lastEntry = entry - &m_cache[0];
+	}
+	if (entry->block != (int)block)
+	{
+		if (!entry->raw)
+		{
+			entry->raw = (unsigned char *)alignedAlloc(layout().blockBytes);
+		}
+		entry->block = block;
+		memset(entry->unpacked, 0, sizeof(entry->unpacked));
+		if (b.mapped && !intact(b))
+		{
+			// Damaged, it reads as zeros rather than being decoded.
+			memset(entry->raw, 0, layout().blockBytes);
+			memset(entry->unpacked, 1, sizeof(entry->unpacked));
+		}
+		else if (b.packed.empty() && !b.mapped)
+		{
+			// Spilled, page it back in.
+			bool read;
+			if (b.packing != e_compressNone)
+			{
+				entry->packed.resize(b.start[e_columnCount]);
+				read = m_spill->read(b.spillOffset, &entry->packed[0], entry->packed.size());
+			}
+			else
+			{
+				read = m_spill->read(b.spillOffset, entry->raw, layout().blockBytes);
+				memset(entry->unpacked, 1, sizeof(entry->unpacked));
+			}
+			if (!read)
+			{
+				memset(entry->raw, 0, layout().blockBytes);
+				memset(entry->unpacked, 1, sizeof(entry->unpacked));
+			}
+		}
+	}
+	entry->used = ++m_cacheClock;
+	if (!entry->unpacked[column])
+	{
+		const unsigned char *packed = b.mapped ? b.mapped : b.packed.empty() ? &entry->packed[0] : &b.packed[0];
+		unpack(b, packed, column, entry->raw);
+		entry->unpacked[column] = true;
+	}
+	return entry->raw + layout().offset[column];
+}
+
+void SampleStore::pack(Block &block)
+{
+	const ColumnLayout &l = layout();
+	// Packed into a reused buffer first since the size isn't known up front.
+	std::vector<unsigned char> &packed = m_packBuffer;
+	packed.clear();
+	block.positionStep = m_positionStep;
+	for (int c = 0; c < e_columnCount; ++c)
+	{
+		block.start[c] = (unsigned int)packed.size();
+		PackWriter out(packed);
+		const unsigned char *data = block.raw + l.offset[c];
+		switch (m_compression == e_compressLossless ? l.lossless[c] : l.codec[c])
+		{
+		case e_codecBits:
+		{
+			const unsigned int *words = (const unsigned int *)data;
+			size_t count = l.size[c] / sizeof(unsigned int);
+			for (size_t i = 0; i < count; ++i)
+			{
+				out.put(words[i]);
+			}
+			for (size_t i = count; i < count * c_blockSamples; ++i)
+			{
+				out.put(words[i] ^ words[i - count]);
+			}
+			break;
+		}
+		case e_codecFloat:
+		case e_codecDouble:
+		{
+			bool isDouble = l.codec[c] == e_codecDouble;
+			size_t count = l.size[c] / (isDouble ? sizeof(double) : sizeof(float));
+			double step = l.step[c] ? l.step[c] : block.positionStep;
+			long long previous = 0;
+			long long last[16] = {};
+			for (size_t i = 0; i < count * c_blockSamples; ++i)
+			{
+				double value = isDouble ? ((const double *)data)[i] : ((const float *)data)[i];
+				long long q = quantize(value, step);
+				if (l.delta[c])
+				{
+					previous = last[i % count];
+					last[i % count] = q;
+				}
+				out.put(zigzag(q - previous));
+			}
+			break;
+		}
+		case e_codecQuat:
+		{
+			const ovrQuatf *quats = (const ovrQuatf *)data;
+			int lastLargest = 0;
+			long long last[3] = {};
+			for (size_t i = 0; i < c_blockSamples; ++i)
+			{
+				int largest;
+				long long parts[3];
+				smallestThree(quats[i], largest, parts);
+				// Changes of the dropped component ride along in the low bits of the first part.
+				out.put(zigzag(parts[0] - last[0]) << 2 | (largest ^ lastLargest));
+				out.put(zigzag(parts[1] - last[1]));
+				out.put(zigzag(parts[2] - last[2]));
+				lastLargest = largest;
+				memcpy(last, parts, sizeof(last));
+			}
+			break;
+		}
+		case e_codecXor:
+		{
+			// A component at a time, x with x and so on, since those are the values that are alike.
+			BitWriter bits(packed);
+			size_t count = l.size[c] / sizeof(unsigned int);
+			for (size_t i = 0; i < count; ++i)
+			{
+				packXor(bits, (const unsigned int *)data + i, count);
+			}
+			bits.flush();
+			break;
+		}
+		case e_codecTimestamp:
+		{
+			BitWriter bits(packed);
+			packTimestamps(bits, (const unsigned long long *)data);
+			bits.flush();
+			break;
+		}
+		}
+		out.flush();
+	}
+	block.start[e_columnCount] = (unsigned int)packed.size();
+	block.packing = m_compression;
+	// A block recycled by a full ring keeps its old buffer, so this only allocates if it has to grow.
+	block.packed.assign(packed.begin(), packed.end());
+	m_pool.push_back(block.raw);
+	block.raw = 0;
+}
+
+void SampleStore::unpack(const Block &block, const unsigned char *packed, int column, unsigned char *raw) const
+{
+	const ColumnLayout &l = layout();
+	const unsigned char *end = packed + block.start[column + 1];
+	PackReader in(packed + block.start[column], end);
+	BitReader bits(packed + block.start[column], end);
+	unsigned char *data = raw + l.offset[column];
+	switch (block.packing == e_compressLossless ? l.lossless[column] : l.codec[column])
+	{
+	case e_codecBits:
+	{
+		unsigned int *words = (unsigned int *)data;
+		size_t count = l.size[column] / sizeof(unsigned int);
+		for (size_t i = 0; i < count; ++i)
+		{
+			words[i] = (unsigned int)in.get();
+		}
+		for (size_t i = count; i < count * c_blockSamples; ++i)
+		{
+			words[i] = words[i - count] ^ (unsigned int)in.get();
+		}
+		break;
+	}
+	case e_codecFloat:
+	case e_codecDouble:
+	{
+		bool isDouble = l.codec[column] == e_codecDouble;
+		size_t count = l.size[column] / (isDouble ? sizeof(double) : sizeof(float));
+		double step = l.step[column] ? l.step[column] : block.positionStep;
+		long long last[16] = {};
+		for (size_t i = 0; i < count * c_blockSamples; ++i)
+		{
+			long long q = unzigzag(in.get());
+			if (l.delta[column])
+			{
+				if (!addDelta(last[i % count], q))
+				{
+					in.fail();
+				}
+				q = last[i % count];
+			}
+			if (isDouble)
+				((double *)data)[i] = q * step;
+			else
+				((float *)data)[i] = (float)(q * step);
+		}
+		break;
+	}
+	case e_codecQuat:
+	{
+		ovrQuatf *quats = (ovrQuatf *)data;
+		int largest = 0;
+		long long parts[3] = {};
+		for (size_t i = 0; i < c_blockSamples; ++i)
+		{
+			unsigned long long first = in.get();
+			largest ^= (int)(first & 3);
+			if (!addDelta(parts[0], unzigzag(first >> 2)) || !addDelta(parts[1], unzigzag(in.get())) || !addDelta(parts[2], unzigzag(in.get())))
+			{
+				in.fail();
+			}
+			quats[i] = fromSmallestThree(largest, parts);
+		}
+		break;
+	}
+	case e_codecXor:
+	{
+		size_t count = l.size[column] / sizeof(unsigned int);
+		for (size_t i = 0; i < count; ++i)
+		{
+			unpackXor(bits, (unsigned int *)data + i, count);
+		}
+		break;
+	}
+	case e_codecTimestamp:
+	{
+		unpackTimestamps(bits, (unsigned long long *)data);
+		break;
+	}
+	}
+	if (in.failed() || bits.failed())
+	{
+		// Damaged, zeros rather than whatever it decoded to.
+		memset(data, 0, l.size[column] * c_blockSamples);
+	}
+}
+
+bool SampleStore::intact(const Block &block) const
+{
+	if (block.mapped && !block.intact)
+	{
+		block.intact = crc32c(block.mapped, blockBytes(block)) == block.crc ? 1 : -1;
+	}
+	return !block.mapped || block.intact > 0;
+}
+
+void SampleStore::setCapacity(unsigned int blocks)
+{
+	clear();
+	m_capacity = blocks;
+	m_blocks.reserve(blocks);
+}
+
+void SampleStore::setMemoryBudget(size_t bytes)
+{
+	m_budget = bytes;
+}
+
+size_t SampleStore::blockBytes(const Block &block) const
+{
+	return block.packing != e_compressNone ? block.start[e_columnCount] : layout().blockBytes;
+}
+
+void SampleStore::spill()
+{
+	// Free blocks the writer has finished with.
+	while (m_spillFreed < m_spillQueued)
+	{
+		Block &block = m_blocks[m_spillFreed];
+		if (block.mapped)
+		{
+			m_spillFreed++;
+			continue;
+		}
+		if (block.spillOffset + (long long)blockBytes(block) > m_spill->written())
+		{
+			break;
+		}
+		if (block.raw)
+		{
+			// Into the pool, the block being filled will need one soon.
+			m_pool.push_back(block.raw);
+			block.raw = 0;
+		}
+		std::vector<unsigned char>().swap(block.packed);
+		std::vector<unsigned char>().swap(block.record);
+		m_spillFreed++;
+	}
+
+	if (m_spill && m_spill->failed())
+	{
+		return;
+	}
+	// Queue the oldest full blocks until what's left fits, or all of them when streaming (c_streamBurst at a time). The
+	// block being filled always stays.
+	size_t used = memoryUsed();
+	for (unsigned int i = m_spillFreed; i < m_spillQueued; ++i)
+	{
+		used -= blockBytes(m_blocks[i]);
+	}
+	unsigned int burst = 0;
+	while ((m_streaming || used > m_budget) && m_spillQueued + 1 < m_blocks.size())
+	{
+		if (m_streaming && burst == c_streamBurst)
+		{
+			break;
+		}
+		Block &block = m_blocks[m_spillQueued];
+		if (block.mapped)
+		{
+			// Already on disk, in the recording file.
+			m_spillQueued++;
+			continue;
+		}
+		if (!m_spill)
+		{
+			m_spill = std::make_shared<SpillFile>();
+			if (!m_spill->open())
+			{
+				return;
+			}
+		}
+		if (m_spill->backlog() > c_maxBacklog)
+		{
+			// The disk isn't keeping up, try again when the next block is full.
+			m_stalls++;
+			break;
+		}
+		queueBlock(m_spillQueued);
+		used -= blockBytes(block);
+		m_spillQueued++;
+		burst++;
+	}
+}
+
+void SampleStore::streamTo(const std::shared_ptr<SpillFile> &file)
+{
+	m_spill = file;
+	m_streaming = true;
+}
+
+void SampleStore::finishStream(std::vector<FileBlock> &index)
+{
+	for (; m_spillQueued < m_blocks.size() && m_spill && !m_spill->failed(); ++m_spillQueued)
+	{
+		queueBlock(m_spillQueued);
+	}
+	for (size_t i = 0; i < m_blocks.size(); ++i)
+	{
+		index.push_back(fileBlock(m_blocks[i]));
+	}
+	m_streaming = false;
+}
+
+void SampleStore::queueBlock(unsigned int index)
+{
+	Block &block = m_blocks[index];
+	const void *data = block.raw ? (const void *)block.raw : (const void *)&block.packed[0];
+	if (!m_streaming)
+	{
+		block.spillOffset = m_spill->append(data, blockBytes(block), c_blockAlignment);
+		return;
+	}
+
+	// The record goes first, it has to say where the block will land. Nothing else appends to a stream meanwhile.
+	block.crc = crc32c(data, blockBytes(block));
+	BlockRecord record;
+	memset(&record, 0, sizeof(record));
+	memcpy(record.magic, g_blockRecordMagic, sizeof(record.magic));
+	unsigned int first = index << c_blockShift;
+	record.samples = std::min<unsigned int>(m_size - first, c_blockSamples);
+	std::vector<ButtonEdge>::const_iterator edges[e_buttonFieldCount];
+	size_t bytes = sizeof(record);
+	for (int f = 0; f < e_buttonFieldCount; ++f)
+	{
+		const std::vector<ButtonEdge> &list = m_edges[f];
+		edges[f] = std::lower_bound(list.begin(), list.end(), first, [](const ButtonEdge &edge, unsigned int sample) { return edge.sample < sample; });
+		std::vector<ButtonEdge>::const_iterator end = std::lower_bound(edges[f], list.end(), first + record.samples, [](const ButtonEdge &edge, unsigned int sample) { return edge.sample < sample; });
+		record.edgeCount[f] = (unsigned int)(end - edges[f]);
+		bytes += record.edgeCount[f] * sizeof(ButtonEdge);
+	}
+	long long recordOffset = (m_spill->queued() + c_blockAlignment - 1) & ~(long long)(c_blockAlignment - 1);
+	record.block = fileBlock(block);
+	record.block.offset = (recordOffset + bytes + c_blockAlignment - 1) & ~(unsigned long long)(c_blockAlignment - 1);
+
+	block.record.resize(bytes);
+	memcpy(&block.record[0], &record, sizeof(record));
+	unsigned char *out = &block.record[sizeof(record)];
+	for (int f = 0; f < e_buttonFieldCount; ++f)
+	{
+		if (record.edgeCount[f])
+		{
+			memcpy(out, &*edges[f], record.edgeCount[f] * sizeof(ButtonEdge));
+			out += record.edgeCount[f] * sizeof(ButtonEdge);
+		}
+	}
+	size_t checked = offsetof(BlockRecord, crc) + sizeof(record.crc);
+	((BlockRecord *)&block.record[0])->crc = crc32c(&block.record[checked], bytes - checked);
+	block.recordOffset = m_spill->append(&block.record[0], bytes, c_blockAlignment);
+	block.spillOffset = m_spill->append(data, blockBytes(block), c_blockAlignment);
+}
+
+FileBlock SampleStore::fileBlock(const Block &block) const
+{
+	FileBlock entry;
+	entry.offset = block.spillOffset;
+	entry.bytes = (unsigned int)blockBytes(block);
+	entry.packing = block.packing;
+	entry.positionStep = block.positionStep;
+	entry.crc = block.crc;
+	memcpy(entry.start, block.start, sizeof(entry.start));
+	return entry;
+}
+
+unsigned int SampleStore::writtenSamples() const
+{
+	unsigned int blocks = m_spillFreed;
+	while (blocks < m_spillQueued)
+	{
+		const Block &block = m_blocks[blocks];
+		if (!block.mapped && block.spillOffset + (long long)blockBytes(block) > m_spill->written())
+		{
+			break;
+		}
+		blocks++;
+	}
+	unsigned int samples = blocks << c_blockShift;
+	return samples < m_size ? samples : m_size;
+}
+
+unsigned long long SampleStore::spilled() const
+{
+	unsigned long long bytes = 0;
+	for (unsigned int i = 0; i < m_blocks.size(); ++i)
+	{
+		const Block &block = m_blocks[i];
+		if (!block.raw && block.packed.empty() && !block.mapped)
+		{
+			bytes += blockBytes(block);
+		}
+	}
+	return bytes;
+}
+
+bool SampleStore::writeBlocks(FILE *file, unsigned long long &offset, std::vector<FileBlock> &index) const
+{
+	static const unsigned char padding[c_blockAlignment] = {};
+	std::vector<unsigned char> buffer;
+	if (m_spill)
+	{
+		m_spill->flush();
+	}
+	for (unsigned int i = 0; i < m_blocks.size(); ++i)
+	{
+		const Block &block = m_blocks[i];
+		size_t pad = (size_t)(c_blockAlignment - offset % c_blockAlignment) % c_blockAlignment;
+		if (pad && fwrite(padding, 1, pad, file) != pad)
+		{
+			return false;
+		}
+		offset += pad;
+
+		FileBlock entry = fileBlock(block);
+		entry.offset = offset;
+		const unsigned char *data;
+		if (block.raw)
+		{
+			data = block.raw;
+		}
+		else if (block.mapped)
+		{
+			data = block.mapped;
+		}
+		else if (!block.packed.empty())
+		{
+			data = &block.packed[0];
+		}
+		else
+		{
+			buffer.resize(entry.bytes);
+			if (!m_spill->read(block.spillOffset, &buffer[0], entry.bytes))
+			{
+				return false;
+			}
+			data = &buffer[0];
+		}
+		// A mapped block keeps the checksum it was recorded with, so damage to it isn't saved as if it were intact.
+		entry.crc = block.mapped ? block.crc : crc32c(data, entry.bytes);
+		if (fwrite(data, 1, entry.bytes, file) != entry.bytes)
+		{
+			return false;
+		}
+		offset += entry.bytes;
+		index.push_back(entry);
+	}
+	return true;
+}
+
+void SampleStore::mapBlocks(const std::shared_ptr<const MappedFile> &file, const std::vector<FileBlock> &index, unsigned int size)
+{
+	clear();
+	m_mapping = file;
+	m_blocks.resize(index.size());
+	for (size_t i = 0; i < index.size(); ++i)
+	{
+		Block &block = m_blocks[i];
+		block.mapped = file->data() + index[i].offset;
+		block.packing = (Compression)index[i].packing;
+		block.positionStep = index[i].positionStep;
+		block.crc = index[i].crc;
+		memcpy(block.start, index[i].start, sizeof(block.start));
+	}
+	m_size = size;
+
+	// A partly filled last block may be added to, so it gets memory of its own.
+	if ((size & c_blockMask) && !m_blocks.empty())
+	{
+		Block &last = m_blocks.back();
+		last.raw = allocateBlock();
+		if (!intact(last))
+		{
+			memset(last.raw, 0, layout().blockBytes);
+		}
+		else if (last.packing == e_compressNone)
+		{
+			memcpy(last.raw, last.mapped, layout().blockBytes);
+		}
+		else
+		{
+			for (int c = 0; c < e_columnCount; ++c)
+			{
+				unpack(last, last.mapped, c, last.raw);
+			}
+		}
+		last.mapped = 0;
+		last.packing = e_compressNone;
+	}
+}
+
+void SampleStore::setEdges(ButtonField field, const std::vector<ButtonEdge> &edges)
+{
+	m_edges[field] = edges;
+	indexEdges(field);
+}
+
+void SampleStore::setCompression(Compression mode, float positionError)
+{
+	m_compression = mode;
+	// Rounding to the nearest step is off by at most half a step.
+	m_positionStep = positionError * 2.0f;
+	if (mode != e_compressNone)
+	{
+		// Blocks already queued for spilling are left alone, the writer may still be reading them.
+		for (size_t i = m_spillQueued; i < m_blocks.size(); ++i)
+		{
+			if (m_blocks[i].raw && blockSize((unsigned int)i) == c_blockSamples)
+			{
+				pack(m_blocks[i]);
+			}
+		}
+	}
+}
+
+VRState SampleStore::get(unsigned int index) const
+{
+	VRState state;
+	get(index, state);
+	return state;
+}
+
+void SampleStore::get(unsigned int index, VRState &state) const
+{
+	// Anything not stored in a column (struct padding) comes back as zero.
+	memset(&state, 0, sizeof(state));
+	const ColumnLayout &l = layout();
+	unsigned int block = index >> c_blockShift;
+	unsigned int slot = index & c_blockMask;
+	for (int i = 0; i < e_columnCount; ++i)
+	{
+		memcpy((unsigned char *)&state + l.source[i], columnData(block, i) + slot * l.size[i], l.size[i]);
+	}
+	state.remoteButtons = buttons(index, e_buttonRemote);
+	state.touchButtons = buttons(index, e_buttonTouch);
+	state.touchTouch = buttons(index, e_buttonTouchTouch);
+}
+
+void SampleStore::get(unsigned int index, VRState &state, const std::vector<int> &columns) const
+{
+	const ColumnLayout &l = layout();
+	unsigned int block = index >> c_blockShift;
+	unsigned int slot = index & c_blockMask;
+	for (size_t i = 0; i < columns.size(); ++i)
+	{
+		int c = columns[i];
+		memcpy((unsigned char *)&state + l.source[c], columnData(block, c) + slot * l.size[c], l.size[c]);
+	}
+	state.remoteButtons = buttons(index, e_buttonRemote);
+	state.touchButtons = buttons(index, e_buttonTouch);
+	state.touchTouch = buttons(index, e_buttonTouchTouch);
+}
+
+VRState SampleStore::front() const
+{
+	return get(0);
+}
+
+VRState SampleStore::back() const
+{
+	return get(m_size - 1);
+}
+
+void SampleStore::push_back(const VRState &state)
+{
+	if ((m_size & c_blockMask) == 0 && (m_size >> c_blockShift) == m_blocks.size())
+	{
+		if (m_compression != e_compressNone && !m_blocks.empty())
+		{
+			pack(m_blocks.back());
+		}
+		if (m_budget || m_streaming)
+		{
+			spill();
+		}
+		if (m_capacity && m_blocks.size() == m_capacity)
+		{
+			// Full, the oldest block moves to the end and is reused.
+			std::rotate(m_blocks.begin(), m_blocks.begin() + 1, m_blocks.end());
+			m_blocks.back().packed.clear();
+			m_blocks.back().packing = e_compressNone;
+			m_size -= c_blockSamples;
+			m_discarded += c_blockSamples;
+			clearCache();
+			trimEdges(c_blockSamples);
+		}
+		else
+		{
+			m_blocks.push_back(Block());
+		}
+		if (!m_blocks.back().raw)
+		{
+			m_blocks.back().raw = allocateBlock();
+		}
+	}
+	const ColumnLayout &l = layout();
+	unsigned char *block = m_blocks[m_size >> c_blockShift].raw;
+	unsigned int slot = m_size & c_blockMask;
+	for (int i = 0; i < e_columnCount; ++i)
+	{
+		memcpy(block + l.offset[i] + slot * l.size[i], (const unsigned char *)&state + l.source[i], l.size[i]);
+	}
+	addEdge(e_buttonRemote, m_size, state.time, state.remoteButtons);
+	addEdge(e_buttonTouch, m_size, state.time, state.touchButtons);
+	addEdge(e_buttonTouchTouch, m_size, state.time, state.touchTouch);
+	m_size++;
+}
+
+void SampleStore::clear()
+{
+	if (m_spill)
+	{
+		// Queued writes point at our blocks.
+		m_spill->flush();
+		m_spill.reset();
+	}
+	m_mapping.reset();
+	m_spillQueued = 0;
+	m_spillFreed = 0;
+	m_streaming = false;
+	m_stalls = 0;
+	for (size_t i = 0; i < m_blocks.size(); ++i)
+	{
+		if (m_blocks[i].raw)
+			m_pool.push_back(m_blocks[i].raw);
+	}
+	m_blocks.clear();
+	m_size = 0;
+	m_discarded = 0;
+	for (int i = 0; i < e_buttonFieldCount; ++i)
+	{
+		m_edges[i].clear();
+		indexEdges((ButtonField)i);
+	}
+	clearCache();
+}
+
+void SampleStore::addEdge(ButtonField field, unsigned int sample, double time, unsigned int value)
+{
+	std::vector<ButtonEdge> &edges = m_edges[field];
+	unsigned int last = edges.empty() ? 0 : edges.back().after;
+	if (value == last)
+	{
+		return;
+	}
+	ButtonEdge edge = { sample, time, last, value };
+	edges.push_back(edge);
+	for (unsigned int changed = last ^ value; changed; changed &= changed - 1)
+	{
+		m_bitEdges[field][trailingZeros(changed)].push_back((unsigned int)edges.size() - 1);
+	}
+}
+
+void SampleStore::indexEdges(ButtonField field)
+{
+	const std::vector<ButtonEdge> &edges = m_edges[field];
+	for (int bit = 0; bit < 32; ++bit)
+	{
+		m_bitEdges[field][bit].clear();
+	}
+	for (size_t i = 0; i < edges.size(); ++i)
+	{
+		for (unsigned int changed = edges[i].before ^ edges[i].after; changed; changed &= changed - 1)
+		{
+			m_bitEdges[field][trailingZeros(changed)].push_back((unsigned int)i);
+		}
+	}
+}
+
+void SampleStore::trimEdges(unsigned int samples)
+{
+	for (int i = 0; i < e_buttonFieldCount; ++i)
+	{
+		std::vector<ButtonEdge> &edges = m_edges[i];
+		std::vector<ButtonEdge>::iterator kept = std::upper_bound(edges.begin(), edges.end(), samples, [](unsigned int s, const ButtonEdge &edge) { return s < edge.sample; });
+		if (kept == edges.begin())
+		{
+			for (size_t j = 0; j < edges.size(); ++j)
+				edges[j].sample -= samples;
+			continue;
+		}
+		// The value at the new first sample becomes a change from 0 there, so anything held is still a press.
+		ButtonEdge first = *(kept - 1);
+		edges.erase(edges.begin(), kept);
+		for (size_t j = 0; j < edges.size(); ++j)
+		{
+			edges[j].sample -= samples;
+		}
+		if (first.after)
+		{
+			first.sample = 0;
+			first.before = 0;
+			if (m_size)
+				first.time = time(0);
+			edges.insert(edges.begin(), first);
+		}
+		indexEdges((ButtonField)i);
+	}
+}
+
+unsigned int SampleStore::buttons(unsigned int index, ButtonField field) const
+{
+	const std::vector<ButtonEdge> &edges = m_edges[field];
+	std::vector<ButtonEdge>::const_iterator it = std::upper_bound(edges.begin(), edges.end(), index, [](unsigned int i, const ButtonEdge &edge) { return i < edge.sample; });
+	return it == edges.begin() ? 0 : (it - 1)->after;
+}
+
+int SampleStore::nextPress(ButtonField field, unsigned int button, unsigned int after) const
+{
+	if (!button)
+	{
+		return -1;
+	}
+	const std::vector<ButtonEdge> &edges = m_edges[field];
+	const std::vector<unsigned int> &changes = m_bitEdges[field][trailingZeros(button)];
+	size_t i = std::upper_bound(changes.begin(), changes.end(), after, [&edges](unsigned int s, unsigned int edge) { return s < edges[edge].sample; }) - changes.begin();
+	// A bit's changes alternate down and up, starting with down.
+	if (i & 1)
+	{
+		++i;
+	}
+	return i < changes.size() ? (int)edges[changes[i]].sample : -1;
+}
+
+int SampleStore::previousPress(ButtonField field, unsigned int button, unsigned int before) const
+{
+	if (!button)
+	{
+		return -1;
+	}
+	const std::vector<ButtonEdge> &edges = m_edges[field];
+	const std::vector<unsigned int> &changes = m_bitEdges[field][trailingZeros(button)];
+	size_t i = std::lower_bound(changes.begin(), changes.end(), before, [&edges](unsigned int edge, unsigned int s) { return edges[edge].sample < s; }) - changes.begin();
+	if (i == 0)
+	{
+		return -1;
+	}
+	--i;
+	if (i & 1)
+	{
+		--i;
+	}
+	return (int)edges[changes[i]].sample;
+}
+
+void SampleStore::presses(ButtonField field, unsigned int button, std::vector<ButtonPress> &out) const
+{
+	out.clear();
+	if (!button || m_size == 0)
+	{
+		return;
+	}
+	const std::vector<ButtonEdge> &edges = m_edges[field];
+	const std::vector<unsigned int> &changes = m_bitEdges[field][trailingZeros(button)];
+	for (size_t i = 0; i < changes.size(); i += 2)
+	{
+		const ButtonEdge &down = edges[changes[i]];
+		ButtonPress press;
+		press.start = down.sample;
+		if (i + 1 < changes.size())
+		{
+			press.end = edges[changes[i + 1]].sample;
+			press.duration = edges[changes[i + 1]].time - down.time;
+		}
+		else
+		{
+			press.end = m_size;
+			press.duration = time(m_size - 1) - down.time;
+		}
+		out.push_back(press);
+	}
+}
+
+void SampleStore::unpackAll(unsigned int threads)
+{
+	// Memory for every block first, the pool isn't shared between threads.
+	std::vector<unsigned int> blocks;
+	for (unsigned int i = 0; i < m_blocks.size(); ++i)
+	{
+		if (unpackable(i))
+		{
+			m_blocks[i].raw = allocateBlock();
+			blocks.push_back(i);
+		}
+	}
+	if (threads == 0)
+	{
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threads = (unsigned int)std::min<size_t>(threads, std::max<size_t>(blocks.size(), 1));
+
+	// Each block is independent, so they're handed out one at a time and unpacked into place.
+	std::atomic<size_t> next(0);
+	auto work = [&]
+	{
+		for (size_t i = next++; i < blocks.size(); i = next++)
+		{
+			Block &block = m_blocks[blocks[i]];
+			const unsigned char *packed = block.mapped ? block.mapped : &block.packed[0];
+			if (!intact(block))
+			{
+				memset(block.raw, 0, layout().blockBytes);
+				continue;
+			}
+			for (int c = 0; c < e_columnCount; ++c)
+			{
+				unpack(block, packed, c, block.raw);
+			}
+		}
+	};
+	std::vector<std::thread> workers;
+	for (unsigned int i = 1; i < threads; ++i)
+	{
+		workers.push_back(std::thread(work));
+	}
+	work();
+	for (size_t i = 0; i < workers.size(); ++i)
+	{
+		workers[i].join();
+	}
+
+	for (size_t i = 0; i < blocks.size(); ++i)
+	{
+		Block &block = m_blocks[blocks[i]];
+		block.mapped = 0;
+		block.packing = e_compressNone;
+		std::vector<unsigned char>().swap(block.packed);
+	}
+	clearCache();
+}
+
+unsigned int SampleStore::packedBlocks() const
+{
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < m_blocks.size(); ++i)
+	{
+		if (unpackable(i))
+		{
+			count++;
+		}
+	}
+	return count;
+}
+
+bool SampleStore::unpackable(unsigned int index) const
+{
+	// Packed and readable, and not waiting for the writer, which still needs the packed data.
+	const Block &block = m_blocks[index];
+	bool writing = index >= m_spillFreed && index < m_spillQueued && !block.mapped;
+	return !block.raw && block.packing != e_compressNone && (block.mapped || !block.packed.empty()) && !writing;
+}
+
+void SampleStore::clearCache()
+{
+	for (size_t i = 0; i < m_cache.size(); ++i)
+	{
+		m_cache[i].block = -1;
+		m_cache[i].used = 0;
+	}
+	m_readAheadBlock = -1;
+}
+
+void SampleStore::setCacheBudget(size_t bytes)
+{
+	size_t entries = std::max<size_t>(bytes / layout().blockBytes, c_minCacheBlocks);
+	for (size_t i = entries; i < m_cache.size(); ++i)
+	{
+		if (m_cache[i].raw)
+			alignedFree(m_cache[i].raw);
+	}
+	m_cache.resize(entries);
+	m_lastEntry = 0;
+	clearCache();
+}
+
+size_t SampleStore::cacheBudget() const
+{
+	return m_cache.size() * layout().blockBytes;
+}
+
+void SampleStore::readAhead(unsigned int index, int direction) const
+{
+	int block = (int)(index >> c_blockShift);
+	if (!m_mapping || !direction || (block == m_readAheadBlock && direction == m_readAheadDirection))
+	{
+		return;
+	}
+	m_readAheadBlock = block;
+	m_readAheadDirection = direction;
+	const unsigned char *first = 0;
+	const unsigned char *end = 0;
+	size_t bytes = 0;
+	for (int i = block + direction; i >= 0 && i < (int)m_blocks.size() && bytes < c_readAheadBytes; i += direction)
+	{
+		const Block &ahead = m_blocks[i];
+		if (!ahead.mapped)
+		{
+			break;
+		}
+		size_t size = blockBytes(ahead);
+		first = first ? std::min(first, ahead.mapped) : ahead.mapped;
+		end = std::max(end, ahead.mapped + size);
+		bytes += size;
+	}
+	if (first)
+	{
+		m_mapping->prefetch(first, end - first);
+	}
+}
+
+void SampleStore::releasePool()
+{
+	for (size_t i = 0; i < m_pool.size(); ++i)
+	{
+		alignedFree(m_pool[i]);
+	}
+	m_pool.clear();
+}
+
+size_t SampleStore::memoryUsed() const
+{
+	size_t bytes = m_pool.size() * layout().blockBytes;
+	for (size_t i = 0; i < m_blocks.size(); ++i)
+	{
+		bytes += sizeof(Block) + (m_blocks[i].raw ? layout().blockBytes : m_blocks[i].packed.capacity());
+	}
+	for (size_t i = 0; i < m_cache.size(); ++i)
+	{
+		if (m_cache[i].raw)
+			bytes += layout().blockBytes + m_cache[i].packed.capacity();
+	}
+	for (int i = 0; i < e_buttonFieldCount; ++i)
+	{
+		bytes += m_edges[i].capacity() * sizeof(ButtonEdge);
+		for (int bit = 0; bit < 32; ++bit)
+			bytes += m_bitEdges[i][bit].capacity() * sizeof(unsigned int);
+	}
+	return bytes;
+}
@@ -0,0 +1,387 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#pragma once
+#include "spillfile.h"
+#include <cstdio>
+#include <vector>
+#include <memory>
+
+class MappedFile;
+
+// Included by vrstate.h after VRState, include that rather than this.
+
+// Parts of a device pose stored as separate columns.
+enum PoseColumn
+{
+	e_poseOrientation,		// ovrQuatf
+	e_posePosition,			// ovrVector3f
+	e_poseAngularVelocity,	// ovrVector3f
+	e_poseLinearVelocity,	// ovrVector3f
+	e_poseAngularAcceleration,
+	e_poseLinearAcceleration,
+	e_poseTime,				// double
+	e_poseColumnCount
+};
+
+// Columns of a SampleStore. Each holds one VRState field (arrays such as the two triggers stay together).
+enum SampleColumn
+{
+	e_columnTime,
+	e_columnRuntimeTime,
+	e_columnWallTime,
+	e_columnSampleRate,
+	e_columnEpoch,
+	e_columnLateness,
+	e_columnLatency,
+	e_columnThumbStick,
+	e_columnThumbStickNDZ,
+	e_columnThumbStickRaw,
+	e_columnHandTrigger,
+	e_columnHandTriggerNDZ,
+	e_columnHandTriggerRaw,
+	e_columnIndexTrigger,
+	e_columnIndexTriggerNDZ,
+	e_columnIndexTriggerRaw,
+	e_columnStatusFlags,
+	e_columnHandStatusFlags,
+	e_columnCalibratedOrigin,
+	e_columnObjectFlags,
+	e_columnFreshFlags,
+	e_columnSensorCount,
+	e_columnSensorPose,
+	e_columnPoses,			// First pose column, see poseColumn()
+	e_columnCount = e_columnPoses + e_deviceCount * e_poseColumnCount
+};
+
+// Button and touch words of a VRState. These change a few times a second at most, so a SampleStore keeps them as a
+// list of changes rather than as columns.
+enum ButtonField
+{
+	e_buttonRemote,		// remoteButtons
+	e_buttonTouch,		// touchButtons
+	e_buttonTouchTouch,	// touchTouch
+	e_buttonFieldCount
+};
+
+// A change of one ButtonField.
+struct ButtonEdge
+{
+	unsigned int sample;	// First sample with the new value
+	double time;			// Time of that sample
+	unsigned int before;
+	unsigned int after;
+};
+
+// One press of a button.
+struct ButtonPress
+{
+	unsigned int start;		// Sample it went down
+	unsigned int end;		// Sample it came up, or the sample count if it's still held
+	double duration;
+};
+
+// How full blocks of a SampleStore are packed.
+enum Compression
+{
+	e_compressNone,
+	e_compressQuantized,	// Lossy, to within the bounds given to setCompression()
+	e_compressLossless		// Bit exact, for archiving
+};
+
+// Where a block of a SampleStore is in a recording file, and how to read it. Stored in the file's block index.
+struct FileBlock
+{
+	unsigned long long offset;
+	unsigned int bytes;
+	unsigned int packing;		// Compression
+	float positionStep;
+	unsigned int crc;			// CRC32-C of the block's bytes
+	unsigned int start[e_columnCount + 1];	// Offset of each packed column
+};
+
+// Written ahead of each block of a stream (see SampleStore::streamTo) so the file can still be read back without
+// its index if it's never finished. Followed by the block's button edges, edgeCount of each field in turn, then
+// the block itself on the next cache line.
+struct BlockRecord
+{
+	char magic[8];				// g_blockRecordMagic
+	unsigned int crc;			// CRC32-C of the rest of the record, edges included
+	unsigned int samples;		// Samples in the block
+	unsigned int edgeCount[e_buttonFieldCount];
+	FileBlock block;			// block.offset is where the block itself starts
+};
+
+extern const char g_blockRecordMagic[8];
+
+// Recorded samples, kept in fixed size cache aligned blocks.
+// Blocks are only allocated when samples are added, and are never moved once allocated, so appending is O(1)
+// with no copying of earlier samples. clear() keeps the blocks in a pool for the next recording instead of freeing them.
+// Within a block each column is a contiguous array, so a pass over one channel (eg. a hand position, or the
+// timestamps when seeking) only touches that channel's memory. get() reassembles a whole VRState when needed.
+// With compression on, each block is packed once it is full (see samplestore.cpp for the encoding) and columns
+// are unpacked on demand into a small cache of recently used blocks.
+// With a memory budget, the oldest full blocks are written to a temporary file once the budget is reached and read
+// back through the same cache when needed.
+// A store can also be made from the blocks of a mapped recording file, which are read in place rather than loaded.
+// Buttons and touches are kept as edges, with an index of the edges of each bit, so finding presses doesn't need a
+// pass over the samples. The edges always stay in memory.
+class SampleStore
+{
+public:
+	enum
+	{
+		c_blockShift = 10,
+		c_blockSamples = 1 << c_blockShift,	// Samples per block
+		c_blockMask = c_blockSamples - 1,
+		c_minCacheBlocks = 4,				// Unpacked blocks kept for packed recordings, at least
+		c_cacheBytes = 64 << 20,			// Default memory for them
+		c_readAheadBytes = 8 << 20,			// Asked for ahead of reading a mapped file in order
+		c_maxBacklog = 64 << 20,			// Bytes queued for writing before blocks wait in memory instead
+		c_streamBurst = 4					// Blocks queued at once while streaming, so a backlog is checkpointed as it goes
+	};
+
+	SampleStore();
+	SampleStore(const SampleStore &other);
+	// Copies the samples and button edges. Blocks in memory are copied, blocks only in the spill file or a mapped
+	// recording are shared with the original (the file stays open while either uses it). The compression, capacity,
+	// memory and cache budgets aren't copied, nor is streaming.
+	SampleStore &operator=(const SampleStore &other);
+	~SampleStore();
+
+	unsigned int size() const
+	{
+		return m_size;
+	}
+
+	bool empty() const
+	{
+		return m_size == 0;
+	}
+
+	// Whole samples.
+	VRState get(unsigned int index) const;
+	void get(unsigned int index, VRState &state) const;
+	// Only the listed columns (and the buttons) are written into state, the rest is left alone.
+	void get(unsigned int index, VRState &state, const std::vector<int> &columns) const;
+	VRState front() const;
+	VRState back() const;
+
+	void push_back(const VRState &state);
+	// Remove all samples. The blocks go back to the pool.
+	void clear();
+	// Free the pooled blocks.
+	void releasePool();
+
+	// Pack full blocks from now on (and any already full ones when turning it on). Quantized packing keeps positions
+	// to within positionError metres, orientations to about 0.002 degrees, analog inputs and velocities to a few parts
+	// in 100000. Lossless packing is bit exact and takes around two and a half times the space. Changing it only
+	// affects blocks filled afterwards.
+	void setCompression(Compression mode, float positionError = 0.0001f);
+	// Unpack every packed block in memory or in a mapped file, spread over threads (0 for one per core). Columns are
+	// then read directly instead of through the cache, for playback and export of a whole recording. Takes as much
+	// memory as an uncompressed recording. Blocks waiting to be written, or only on disk, are left as they are.
+	void unpackAll(unsigned int threads = 0);
+	// Blocks that unpackAll() would unpack.
+	unsigned int packedBlocks() const;
+	// Memory for recently used unpacked blocks of a packed, spilled or mapped recording, which are otherwise unpacked
+	// (or read) again each time they're used. Least recently used blocks are dropped first.
+	void setCacheBudget(size_t bytes);
+	size_t cacheBudget() const;
+	// Ask for the next c_readAheadBytes of a mapped recording after (direction 1) or before (-1) the block holding
+	// index to be paged in from disk, so it's there by the time playback or an export gets to it. Repeating the last
+	// request does nothing, so it can be called for every sample.
+	void readAhead(unsigned int index, int direction) const;
+	Compression compression() const
+	{
+		return m_compression;
+	}
+
+	// Keep at most this many blocks (0 for no limit). Once full the oldest block is dropped and its memory reused
+	// for the next one, so a full store never allocates. Clears the store.
+	void setCapacity(unsigned int blocks);
+	// Keep roughly this many bytes in memory (0 for no limit), spilling the oldest full blocks to disk beyond that.
+	// Not for use with setCapacity().
+	void setMemoryBudget(size_t bytes);
+	// Bytes of this store that are only on disk.
+	unsigned long long spilled() const;
+	// True if the spill file couldn't be created or written, everything stays in memory.
+	bool spillFailed() const
+	{
+		return m_spill && m_spill->failed();
+	}
+	// Write each block to file as soon as it's full, as well as anything spilled, freeing its memory once written.
+	// Each block is preceded by a BlockRecord.
+	// Adding samples never waits on the disk: while the writer is more than c_maxBacklog behind, full blocks stay in
+	// memory and are queued later. Call on an empty store, clear() stops it.
+	void streamTo(const std::shared_ptr<SpillFile> &file);
+	// Queue everything not yet queued, including the partly filled last block, and describe where every block went
+	// for the file's index. Nothing should be added after this.
+	void finishStream(std::vector<FileBlock> &index);
+	// Blocks queued for writing so far, and where the BlockRecord of one of them went when streaming.
+	unsigned int queuedBlocks() const
+	{
+		return m_spillQueued;
+	}
+	long long recordOffset(unsigned int block) const
+	{
+		return m_blocks[block].recordOffset;
+	}
+	// Samples at the front whose blocks have been written to the spill or stream file.
+	unsigned int writtenSamples() const;
+	// Times a full block had to wait in memory because the writer was too far behind.
+	unsigned int stalls() const
+	{
+		return m_stalls;
+	}
+	// Samples dropped from the front since the last clear().
+	unsigned long long discarded() const
+	{
+		return m_discarded;
+	}
+
+	// Single values and whole columns. T must match the column's type.
+	// For packed blocks the pointer is only valid until columns from c_minCacheBlocks other blocks have been read.
+	template<typename T>
+	const T &at(unsigned int index, int column) const
+	{
+		return this->column<T>(index >> c_blockShift, column)[index & c_blockMask];
+	}
+
+	template<typename T>
+	const T *column(unsigned int block, int column) const
+	{
+		return (const T *)columnData(block, column);
+	}
+
+	double time(unsigned int index) const
+	{
+		return at<double>(index, e_columnTime);
+	}
+
+	unsigned int blockCount() const
+	{
+		return (unsigned int)m_blocks.size();
+	}
+
+	// Number of samples in the given block, only the last block can be partly filled.
+	unsigned int blockSize(unsigned int block) const
+	{
+		unsigned int start = block << c_blockShift;
+		return m_size - start < (unsigned int)c_blockSamples ? m_size - start : (unsigned int)c_blockSamples;
+	}
+
+	// Value of a button field at the given sample.
+	unsigned int buttons(unsigned int index, ButtonField field) const;
+	// Every change of a field, oldest first. The first is from 0.
+	const std::vector<ButtonEdge> &edges(ButtonField field) const
+	{
+		return m_edges[field];
+	}
+	// Sample where button (a single bit of the field) next goes down after the given sample, or -1 if it doesn't.
+	int nextPress(ButtonField field, unsigned int button, unsigned int after) const;
+	// Sample where button last went down before the given sample, or -1 if it didn't.
+	int previousPress(ButtonField field, unsigned int button, unsigned int before) const;
+	// Every press of button.
+	void presses(ButtonField field, unsigned int button, std::vector<ButtonPress> &out) const;
+
+	// Write every block to file as it is (packed or not), each starting on a cache line so raw blocks can be used in
+	// place once mapped. Where each went is added to index.
+	// offset is where the file is up to, and is moved on past what's written.
+	bool writeBlocks(FILE *file, unsigned long long &offset, std::vector<FileBlock> &index) const;
+	// Replace the samples with the blocks of a mapped recording file. The store (and any copies) keep the mapping
+	// open. Edges have to be set separately.
+	void mapBlocks(const std::shared_ptr<const MappedFile> &file, const std::vector<FileBlock> &index, unsigned int size);
+	void setEdges(ButtonField field, const std::vector<ButtonEdge> &edges);
+
+	static int poseColumn(int device, PoseColumn part)
+	{
+		return e_columnPoses + device * e_poseColumnCount + part;
+	}
+
+	static size_t columnOffset(int column);
+	static size_t columnSize(int column);
+	// Most a block should take in a file. Packed blocks are usually far smaller than raw ones, but noisy columns can
+	// cost a little more than their raw bits.
+	static size_t maxBlockBytes();
+
+	// Bytes allocated, including pooled blocks and the unpack cache, but not what has been spilled.
+	size_t memoryUsed() const;
+
+protected:
+	struct Block
+	{
+		unsigned char *raw;						// Column arrays, null once packed or spilled
+		std::vector<unsigned char> packed;		// Packed columns, one after another. Empty once spilled
+		const unsigned char *mapped;			// The block in a mapped file (packed or not), or null
+		unsigned int start[e_columnCount + 1];	// Offset of each column in packed
+		float positionStep;
+		Compression packing;					// How packed was made, e_compressNone if it wasn't
+		long long spillOffset;					// Where the block is in the spill file, -1 if it hasn't been spilled
+		long long recordOffset;					// Where its BlockRecord is when streaming, otherwise -1
+		unsigned int crc;						// Checksum of the block as streamed or mapped
+		mutable int intact;						// Mapped blocks: 0 until first used, then 1 if crc matched, -1 if not
+		std::vector<unsigned char> record;		// The BlockRecord and edges, until written
+
+		Block() : raw(0), mapped(0), start(), positionStep(0), packing(e_compressNone), spillOffset(-1), recordOffset(-1), crc(0), intact(0)
+		{
+		}
+	};
+
+	struct CacheEntry
+	{
+		int block;								// -1 if unused
+		unsigned char *raw;
+		std::vector<unsigned char> packed;		// A packed block read back from the spill file
+		unsigned long long used;				// For least recently used replacement
+		bool unpacked[e_columnCount];
+
+		CacheEntry() : block(-1), raw(0), used(0)
+		{
+		}
+	};
+
+	unsigned char *allocateBlock();
+	const unsigned char *columnData(unsigned int block, int column) const;
+	void pack(Block &block);
+	void unpack(const Block &block, const unsigned char *packed, int column, unsigned char *raw) const;
+	// Whether a block can be used, mapped ones are checked against their checksum the first time.
+	bool intact(const Block &block) const;
+	bool unpackable(unsigned int index) const;
+	void clearCache();
+	size_t blockBytes(const Block &block) const;
+	void spill();
+	void queueBlock(unsigned int index);
+	FileBlock fileBlock(const Block &block) const;
+	void addEdge(ButtonField field, unsigned int sample, double time, unsigned int value);
+	void indexEdges(ButtonField field);
+	void trimEdges(unsigned int samples);
+
+	std::vector<Block> m_blocks;
+	std::vector<unsigned char *> m_pool;
+	unsigned int m_size;
+	unsigned int m_capacity;
+	unsigned long long m_discarded;
+	Compression m_compression;
+	float m_positionStep;
+	std::vector<unsigned char> m_packBuffer;
+	size_t m_budget;
+	std::shared_ptr<SpillFile> m_spill;		// Shared with copies, which may still need spilled blocks
+	std::shared_ptr<const MappedFile> m_mapping;
+	unsigned int m_spillQueued;				// Blocks before this have been queued for writing
+	unsigned int m_spillFreed;				// Blocks before this have been written, and their memory freed
+	bool m_streaming;
+	unsigned int m_stalls;
+	std::vector<ButtonEdge> m_edges[e_buttonFieldCount];
+	std::vector<unsigned int> m_bitEdges[e_buttonFieldCount][32];	// Indices into m_edges of the changes of each bit
+	mutable std::vector<CacheEntry> m_cache;
+	mutable unsigned long long m_cacheClock;
+	mutable size_t m_lastEntry;				// Cache entry of the last packed column read, checked first
+	mutable int m_readAheadBlock;			// Last readAhead() request
+	mutable int m_readAheadDirection;
+};
@@ -0,0 +1,156 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#include "spillfile.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+SpillFile::SpillFile() : m_file(0), m_busy(false), m_running(false), m_queued(0), m_written(0), m_failed(false)
+{
+}
+
+SpillFile::~SpillFile()
+{
+	if (m_running)
+	{
+		flush();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_running = false;
+		}
+		m_wake.notify_one();
+		m_thread.join();
+	}
+	if (m_file)
+	{
+		fclose(m_file);
+	}
+}
+
+bool SpillFile::open()
+{
+#ifdef _WIN32
+	// tmpfile() may try the root of the drive, which normal users can't write to.
+	char folder[MAX_PATH];
+	char path[MAX_PATH];
+	if (!GetTempPathA(MAX_PATH, folder) || !GetTempFileNameA(folder, "omr", 0, path))
+	{
+		return false;
+	}
+	// D: deleted when closed.
+	m_file = fopen(path, "w+bD");
+#else
+	m_file = tmpfile();
+#endif
+	return start();
+}
+
+bool SpillFile::open(const std::string &filename)
+{
+	m_file = fopen(filename.c_str(), "w+b");
+	return start();
+}
+
+bool SpillFile::start()
+{
+	if (!m_file)
+	{
+		m_failed = true;
+		return false;
+	}
+	m_running = true;
+	m_thread = std::thread(&SpillFile::run, this);
+	return true;
+}
+
+long long SpillFile::append(const void *data, size_t size, size_t alignment)
+{
+	static const unsigned char padding[64] = {};
+	long long offset;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		size_t pad = (size_t)((alignment - m_queued % alignment) % alignment);
+		if (pad)
+		{
+			Write write = { padding, pad };
+			m_queue.push_back(write);
+			m_queued += pad;
+		}
+		Write write = { data, size };
+		m_queue.push_back(write);
+		offset = m_queued;
+		m_queued += size;
+	}
+	m_wake.notify_one();
+	return offset;
+}
+
+void SpillFile::flush()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this] { return (m_queue.empty() && !m_busy) || !m_running; });
+}
+
+bool SpillFile::seek(long long offset)
+{
+#ifdef _WIN32
+	return _fseeki64(m_file, offset, SEEK_SET) == 0;
+#else
+	return fseeko(m_file, offset, SEEK_SET) == 0;
+#endif
+}
+
+bool SpillFile::read(long long offset, void *dest, size_t size)
+{
+	if (offset + (long long)size > m_written)
+	{
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(m_fileMutex);
+	return seek(offset) && fread(dest, 1, size, m_file) == size;
+}
+
+void SpillFile::run()
+{
+	while (true)
+	{
+		Write write;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_busy = false;
+			if (m_queue.empty())
+			{
+				m_idle.notify_all();
+			}
+			m_wake.wait(lock, [this] { return !m_queue.empty() || !m_running; });
+			if (m_queue.empty())
+			{
+				break;
+			}
+			write = m_queue.front();
+			m_queue.pop_front();
+			m_busy = true;
+		}
+		if (!m_failed)
+		{
+			std::lock_guard<std::mutex> lock(m_fileMutex);
+			long long end = m_written;
+			if (seek(end) && fwrite(write.data, 1, write.size, m_file) == write.size && fflush(m_file) == 0)
+			{
+				m_written = end + (long long)write.size;
+			}
+			else
+			{
+				// Out of disk space or similar. Nothing more is written, the owner keeps its data in memory.
+				m_failed = true;
+			}
+		}
+	}
+}
@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Append only file, written on a background thread. Temporary files are deleted when closed, named ones are kept.
+// Writes land in the order they were queued, so where each one goes is known as soon as it's queued.
+class SpillFile
+{
+public:
+	SpillFile();
+	~SpillFile();
+
+	// Creates the file in the system temp folder.
+	bool open();
+	// Creates (or replaces) the named file.
+	bool open(const std::string &filename);
+	// Queue data to be appended, returns the offset it will be written at. Zeros are added first to start it on a
+	// multiple of alignment (at most 64).
+	// The data must stay valid and unchanged until written() reaches the end of it.
+	long long append(const void *data, size_t size, size_t alignment = 1);
+	// Bytes written so far. Anything below this can be read back.
+	long long written() const
+	{
+		return m_written;
+	}
+	// End of everything queued so far, where the next append goes.
+	long long queued() const
+	{
+		return m_queued;
+	}
+	// Bytes queued but not written yet.
+	long long backlog() const
+	{
+		return m_queued - m_written;
+	}
+	bool failed() const
+	{
+		return m_failed;
+	}
+	// Block until everything queued has been written (or failed).
+	void flush();
+	bool read(long long offset, void *dest, size_t size);
+
+protected:
+	struct Write
+	{
+		const void *data;
+		size_t size;
+	};
+
+	bool start();
+	void run();
+	bool seek(long long offset);
+
+	FILE *m_file;
+	std::thread m_thread;
+	std::mutex m_mutex;				// Guards the queue
+	std::mutex m_fileMutex;			// Guards the file position, held by the writer thread for one write at a time
+	std::condition_variable m_wake;
+	std::condition_variable m_idle;
+	std::deque<Write> m_queue;
+	bool m_busy;
+	bool m_running;
+	std::atomic<long long> m_queued;	// End of the last queued write
+	std::atomic<long long> m_written;
+	std::atomic<bool> m_failed;
+};
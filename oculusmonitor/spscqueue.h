@@ -0,0 +1,71 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#pragma once
+#include <atomic>
+#include <vector>
+
+// Lock free single producer / single consumer ring buffer.
+// One thread may call push(), one other thread may call pop(). Capacity is rounded up to a power of two.
+template<typename T>
+class SPSCQueue
+{
+public:
+	SPSCQueue(unsigned int capacity) : m_head(0), m_tail(0)
+	{
+		unsigned int size = 1;
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+		m_items.resize(size);
+		m_mask = size - 1;
+	}
+
+	// Producer side. Returns false (and drops the value) if the queue is full.
+	bool push(const T &value)
+	{
+		unsigned int tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) > m_mask)
+		{
+			return false;
+		}
+		m_items[tail & m_mask] = value;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side. Returns false if the queue is empty.
+	bool pop(T &value)
+	{
+		unsigned int head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		value = m_items[head & m_mask];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	unsigned int size() const
+	{
+		return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+	}
+
+	unsigned int capacity() const
+	{
+		return m_mask + 1;
+	}
+
+protected:
+	std::vector<T> m_items;
+	unsigned int m_mask;
+	alignas(64) std::atomic<unsigned int> m_head;
+	alignas(64) std::atomic<unsigned int> m_tail;
+};
@@ -0,0 +1,450 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#include "synthsource.h"
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// Step used to differentiate the trajectories for velocity and acceleration.
+	const double c_step = 0.001;
+
+	// Thumbstick dead zone applied to the normal (non NDZ) values.
+	const float c_deadZone = 0.2f;
+
+	// Buttons driven by random presses. The last two entries are the hand triggers (grips), which aren't buttons.
+	struct SyntheticButton
+	{
+		unsigned int button;
+		unsigned int touch;
+	};
+	const SyntheticButton c_buttons[] =
+	{
+		{ ovrButton_A, ovrTouch_A },
+		{ ovrButton_B, ovrTouch_B },
+		{ ovrButton_X, ovrTouch_X },
+		{ ovrButton_Y, ovrTouch_Y },
+		{ ovrButton_RThumb, ovrTouch_RThumb },
+		{ ovrButton_LThumb, ovrTouch_LThumb },
+		{ 0, 0 },
+		{ 0, 0 }
+	};
+
+	void gaussianVector(SyntheticRandom &random, float sigma, ovrVector3f &v)
+	{
+		v.x += (float)(random.gaussian() * sigma);
+		v.y += (float)(random.gaussian() * sigma);
+		v.z += (float)(random.gaussian() * sigma);
+	}
+
+	void applyDeadZone(const ovrVector2f &in, ovrVector2f &out)
+	{
+		float length = sqrtf(in.x * in.x + in.y * in.y);
+		float scale = length > c_deadZone ? (length - c_deadZone) / ((1.0f - c_deadZone) * length) : 0.0f;
+		out.x = in.x * scale;
+		out.y = in.y * scale;
+	}
+
+	void sensorDesc(ovrTrackerDesc &desc)
+	{
+		desc.FrustumHFovInRadians = 1.745f;
+		desc.FrustumVFovInRadians = 1.3f;
+		desc.FrustumNearZInMeters = 0.4f;
+		desc.FrustumFarZInMeters = 2.5f;
+	}
+
+	void sensorPose(unsigned int index, ovrTrackerPose &pose)
+	{
+		memset(&pose, 0, sizeof(pose));
+		pose.TrackerFlags = ovrTracker_Connected | ovrTracker_PoseTracked;
+		OVR::Vector3f position(index == 0 ? -1.5f : 1.5f, 2.0f, -1.5f);
+		// Face the centre of the room, tilted down a little.
+		OVR::Quatf yaw(OVR::Vector3f(0, 1, 0), index == 0 ? 2.36f : -2.36f);
+		OVR::Quatf pitch(OVR::Vector3f(1, 0, 0), -0.3f);
+		pose.Pose.Position = position;
+		pose.Pose.Orientation = yaw * pitch;
+		pose.LeveledPose.Position = position;
+		pose.LeveledPose.Orientation = yaw;
+	}
+}
+
+double SyntheticRandom::gaussian()
+{
+	// Sum of four uniforms (Irwin-Hall), scaled to unit variance. Close enough to normal for sensor noise
+	// and much cheaper than Box-Muller, which matters when generating hours of data.
+	unsigned long long bits = next();
+	unsigned int sum = (unsigned int)(bits & 0xffff) + (unsigned int)((bits >> 16) & 0xffff) + (unsigned int)((bits >> 32) & 0xffff) + (unsigned int)(bits >> 48);
+	return (sum * (1.0 / 65536.0) - 2.0) * 1.7320508075688772;
+}
+
+double SyntheticRandom::exponential(double mean)
+{
+	return -log(1.0 - uniform()) * mean;
+}
+
+void SyntheticEvent::reset(double rateHz, double length, double t, SyntheticRandom &random)
+{
+	rate = rateHz;
+	duration = length;
+	start = end = t;
+	active(t, random);
+}
+
+bool SyntheticEvent::active(double t, SyntheticRandom &random)
+{
+	if (rate <= 0)
+	{
+		return false;
+	}
+	while (t >= end)
+	{
+		start = end + random.exponential(1.0 / rate);
+		end = start + duration * (0.5 + random.uniform());
+	}
+	return t >= start;
+}
+
+SyntheticSource::SyntheticSource(const SyntheticParams &params) : m_params(params), m_index(0), m_infoSent(false)
+{
+}
+
+SyntheticSource::SyntheticSource(double rateHz, double duration, bool realtime) : m_index(0), m_infoSent(false)
+{
+	m_params.rate = rateHz;
+	m_params.duration = duration;
+	m_params.realtime = realtime;
+}
+
+const SyntheticParams &SyntheticSource::params() const
+{
+	return m_params;
+}
+
+void SyntheticSource::begin()
+{
+	m_index = 0;
+	m_infoSent = false;
+	m_start = std::chrono::steady_clock::now();
+	if (m_params.objectCount > 4)
+	{
+		m_params.objectCount = 4;
+	}
+
+	// Everything random comes from the one generator, drawn in a fixed order, so the output only depends on the seed.
+	m_random.setSeed(m_params.seed);
+	for (int i = 0; i < e_deviceCount; ++i)
+	{
+		m_trackingLoss[i].reset(m_params.trackingLossRate / 60.0, m_params.trackingLossTime, 0, m_random);
+		OVR::Vector3f position;
+		OVR::Quatf orientation;
+		pose(i, 0, position, orientation);
+		m_heldPose[i].Position = position;
+		m_heldPose[i].Orientation = orientation;
+		m_cacheIndex[i] = ~0ULL;
+	}
+	for (int i = 0; i < c_sensorCount; ++i)
+	{
+		m_sensorDropout[i].reset(m_params.sensorDropoutRate / 60.0, m_params.sensorDropoutTime, 0, m_random);
+	}
+	for (int i = 0; i < c_buttonCount; ++i)
+	{
+		// A press every few seconds per button, grips held for longer.
+		bool grip = i >= 6;
+		m_buttons[i].reset(m_params.inputs ? (grip ? 0.1 : 0.25) : 0, grip ? 2.0 : 0.2, 0, m_random);
+	}
+}
+
+bool SyntheticSource::paced() const
+{
+	return m_params.realtime;
+}
+
+void SyntheticSource::pose(int device, double t, OVR::Vector3f &position, OVR::Quatf &orientation) const
+{
+	// Slow wandering head with hands and objects moving relative to it, built from incommensurate sines
+	// so the motion doesn't visibly repeat.
+	double s = m_params.motionScale;
+	if (device >= e_deviceObject0)
+	{
+		double angle = s * 0.6 * t + (device - e_deviceObject0) * 1.57;
+		position = OVR::Vector3f((float)cos(angle), (float)(1.0 + s * 0.1 * sin(2.0 * t)), (float)sin(angle));
+		orientation = OVR::Quatf(OVR::Vector3f(0, 1, 0), (float)-angle);
+		return;
+	}
+	OVR::Vector3f head((float)(s * 0.3 * sin(0.5 * t)), (float)(1.7 + s * 0.03 * sin(1.3 * t)), (float)(s * 0.2 * sin(0.37 * t)));
+	OVR::Quatf headYaw(OVR::Vector3f(0, 1, 0), (float)(s * 0.8 * sin(0.3 * t)));
+	if (device == e_deviceHead)
+	{
+		position = head;
+		orientation = headYaw * OVR::Quatf(OVR::Vector3f(1, 0, 0), (float)(s * 0.2 * sin(0.7 * t)));
+	}
+	else
+	{
+		float side = device == e_deviceLeftTouch ? -1.0f : 1.0f;
+		double phase = device == e_deviceLeftTouch ? 0.0 : 1.9;
+		OVR::Vector3f offset(side * 0.25f, (float)(-0.45 + s * 0.15 * sin(1.1 * t + phase)), (float)(-0.35 + s * 0.1 * sin(0.9 * t + phase)));
+		position = head + headYaw * offset;
+		orientation = headYaw * OVR::Quatf(OVR::Vector3f(0, 0, 1), (float)(s * 0.5 * sin(1.7 * t + phase))) * OVR::Quatf(OVR::Vector3f(1, 0, 0), (float)(s * 0.4 * sin(1.3 * t + phase)));
+	}
+}
+
+void SyntheticSource::poseState(int device, double t, ovrPoseStatef &state)
+{
+	OVR::Vector3f *p = m_position[device];
+	OVR::Quatf *q = m_orientation[device];
+	double step = c_step;
+	if (!m_params.realtime && m_cacheIndex[device] + 1 == m_index)
+	{
+		// On the simulated clock samples are evenly spaced, so differentiate across neighbouring samples
+		// and reuse the last two evaluations. This is most of the generation time.
+		step = 1.0 / m_params.rate;
+		p[0] = p[1];
+		p[1] = p[2];
+		q[0] = q[1];
+		q[1] = q[2];
+		pose(device, t + step, p[2], q[2]);
+	}
+	else
+	{
+		if (!m_params.realtime)
+		{
+			step = 1.0 / m_params.rate;
+		}
+		pose(device, t - step, p[0], q[0]);
+		pose(device, t, p[1], q[1]);
+		pose(device, t + step, p[2], q[2]);
+	}
+	m_cacheIndex[device] = m_index;
+	OVR::Vector3f w0 = (q[1] * q[0].Inverted()).ToRotationVector() / (float)step;
+	OVR::Vector3f w1 = (q[2] * q[1].Inverted()).ToRotationVector() / (float)step;
+
+	memset(&state, 0, sizeof(state));
+	state.ThePose.Position = p[1];
+	state.ThePose.Orientation = q[1];
+	state.LinearVelocity = (p[2] - p[0]) / (float)(2.0 * step);
+	state.LinearAcceleration = (p[2] - p[1] * 2.0f + p[0]) / (float)(step * step);
+	state.AngularVelocity = (w0 + w1) * 0.5f;
+	state.AngularAcceleration = (w1 - w0) / (float)step;
+	state.TimeInSeconds = t;
+}
+
+bool SyntheticSource::sample(VRState &state)
+{
+	double t;
+	if (m_params.realtime)
+	{
+		t = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+	}
+	else
+	{
+		t = m_index / m_params.rate;
+	}
+	if (m_params.duration > 0 && t > m_params.duration)
+	{
+		return false;
+	}
+	m_index++;
+
+	memset(&state, 0, sizeof(state));
+	state.time = t;
+	state.runtimeTime = t;
+	state.sampleRate = (float)m_params.rate;
+
+	// Positional tracking needs at least one sensor.
+	bool sensorsTracking = false;
+	state.sensorCount = c_sensorCount;
+	for (unsigned int i = 0; i < c_sensorCount; ++i)
+	{
+		sensorPose(i, state.sensorPose[i]);
+		if (m_sensorDropout[i].active(t, m_random))
+		{
+			state.sensorPose[i].TrackerFlags = 0;
+		}
+		else
+		{
+			sensorsTracking = true;
+		}
+	}
+
+	state.trackingState.StatusFlags = trackDevice(e_deviceHead, t, sensorsTracking, state.trackingState.HeadPose);
+	state.trackingState.HandStatusFlags[0] = trackDevice(e_deviceLeftTouch, t, sensorsTracking, state.trackingState.HandPoses[0]);
+	state.trackingState.HandStatusFlags[1] = trackDevice(e_deviceRightTouch, t, sensorsTracking, state.trackingState.HandPoses[1]);
+	state.trackingState.CalibratedOrigin.Orientation.w = 1;
+	for (unsigned int i = 0; i < m_params.objectCount; ++i)
+	{
+		state.objectFlags |= 1 << i;
+		trackDevice(e_deviceObject0 + i, t, sensorsTracking, state.objectPoses[i]);
+	}
+
+	if (m_params.inputs)
+	{
+		inputs(t, state);
+	}
+	return true;
+}
+
+unsigned int SyntheticSource::trackDevice(int device, double t, bool sensorsTracking, ovrPoseStatef &state)
+{
+	poseState(device, t, state);
+	addNoise(state);
+	// Always advance the event, so the random sequence doesn't depend on the sensors.
+	bool lost = m_trackingLoss[device].active(t, m_random) || !sensorsTracking;
+	if (lost)
+	{
+		// Like the runtime, keep reporting the last known position with the IMU orientation.
+		state.ThePose.Position = m_heldPose[device].Position;
+		memset(&state.LinearVelocity, 0, sizeof(state.LinearVelocity));
+		memset(&state.LinearAcceleration, 0, sizeof(state.LinearAcceleration));
+		return ovrStatus_OrientationTracked;
+	}
+	m_heldPose[device] = state.ThePose;
+	return ovrStatus_OrientationTracked | ovrStatus_PositionTracked;
+}
+
+void SyntheticSource::addNoise(ovrPoseStatef &state)
+{
+	if (m_params.positionNoise > 0)
+	{
+		gaussianVector(m_random, m_params.positionNoise, state.ThePose.Position);
+	}
+	if (m_params.orientationNoise > 0)
+	{
+		// Small angle rotation, the normalise takes care of the approximation.
+		ovrVector3f axis = { 0, 0, 0 };
+		gaussianVector(m_random, m_params.orientationNoise * 0.5f, axis);
+		OVR::Quatf orientation = OVR::Quatf(axis.x, axis.y, axis.z, 1.0f) * OVR::Quatf(state.ThePose.Orientation);
+		state.ThePose.Orientation = orientation.Normalized();
+	}
+	if (m_params.velocityNoise > 0)
+	{
+		gaussianVector(m_random, m_params.velocityNoise, state.LinearVelocity);
+	}
+	if (m_params.angularVelocityNoise > 0)
+	{
+		gaussianVector(m_random, m_params.angularVelocityNoise, state.AngularVelocity);
+	}
+	if (m_params.accelerationNoise > 0)
+	{
+		gaussianVector(m_random, m_params.accelerationNoise, state.LinearAcceleration);
+	}
+}
+
+void SyntheticSource::inputs(double t, VRState &state)
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		if (m_buttons[i].active(t, m_random))
+		{
+			state.touchButtons |= c_buttons[i].button;
+			state.touchTouch |= c_buttons[i].touch;
+		}
+		else if (t > m_buttons[i].start - 0.15)
+		{
+			// Fingers rest on a button briefly before pressing it.
+			state.touchTouch |= c_buttons[i].touch;
+		}
+	}
+	// Enter (menu) once a minute.
+	if (t > 1.0 && fmod(t, 60.0) < 0.1)
+	{
+		state.touchButtons |= ovrButton_Enter;
+	}
+
+	for (int i = 0; i < 2; ++i)
+	{
+		double phase = i * 2.1;
+		// Index trigger squeezed and released in waves, grip held in random bursts.
+		float index = (float)std::max(0.0, sin(0.8 * t + phase));
+		state.touchIndexTrigger[i] = state.touchIndexTriggerNDZ[i] = state.touchIndexTriggerRaw[i] = index;
+		bool gripping = m_buttons[6 + i].active(t, m_random);
+		float grip = 0;
+		if (gripping)
+		{
+			grip = (float)std::min(1.0, (t - m_buttons[6 + i].start) * 8.0);
+		}
+		state.touchHandTrigger[i] = state.touchHandTriggerNDZ[i] = state.touchHandTriggerRaw[i] = grip;
+
+		// Thumbstick pushed around in circles some of the time.
+		double push = std::max(0.0, sin(0.23 * t + phase));
+		double angle = 1.4 * t + phase;
+		ovrVector2f stick = { (float)(push * cos(angle)), (float)(push * sin(angle)) };
+		state.touchThumbStickRaw[i] = stick;
+		state.touchThumbStickNDZ[i] = stick;
+		applyDeadZone(stick, state.touchThumbStick[i]);
+
+		unsigned int indexTouch = i == 0 ? ovrTouch_LIndexTrigger : ovrTouch_RIndexTrigger;
+		unsigned int thumbStick = i == 0 ? ovrTouch_LThumb : ovrTouch_RThumb;
+		unsigned int thumbRest = i == 0 ? ovrTouch_LThumbRest : ovrTouch_RThumbRest;
+		unsigned int thumbButtons = i == 0 ? (ovrTouch_X | ovrTouch_Y) : (ovrTouch_A | ovrTouch_B);
+		unsigned int pointing = i == 0 ? ovrTouch_LIndexPointing : ovrTouch_RIndexPointing;
+		unsigned int thumbUp = i == 0 ? ovrTouch_LThumbUp : ovrTouch_RThumbUp;
+		if (index > 0.05f)
+		{
+			state.touchTouch |= indexTouch;
+		}
+		else if (gripping)
+		{
+			state.touchTouch |= pointing;
+		}
+		if (push > 0.05)
+		{
+			state.touchTouch |= thumbStick;
+		}
+		if (!(state.touchTouch & (thumbStick | thumbButtons)))
+		{
+			state.touchTouch |= (gripping && fmod(t + phase, 7.0) < 1.0) ? thumbUp : thumbRest;
+		}
+	}
+}
+
+bool SyntheticSource::pollDeviceInfo(DeviceInfo &info, double /*now*/)
+{
+	if (m_infoSent)
+	{
+		return false;
+	}
+	memset(&info.hmdDesc, 0, sizeof(info.hmdDesc));
+	strcpy(info.hmdDesc.ProductName, "Synthetic");
+	strcpy(info.hmdDesc.Manufacturer, "Oculus Monitor");
+	info.hmdDesc.AvailableTrackingCaps = ovrTrackingCap_Orientation | ovrTrackingCap_Position;
+	info.hmdDesc.Resolution.w = 2160;
+	info.hmdDesc.Resolution.h = 1200;
+	info.hmdDesc.DisplayRefreshRate = 90.0f;
+	for (int i = 0; i < ovrEye_Count; ++i)
+	{
+		ovrFovPort fov = { 1.3f, 1.3f, 1.1f, 1.1f };
+		info.hmdDesc.DefaultEyeFov[i] = fov;
+		info.hmdDesc.MaxEyeFov[i] = fov;
+	}
+	info.trackingOrigin = ovrTrackingOrigin_FloorLevel;
+	info.connectedControllers = ovrControllerType_LTouch | ovrControllerType_RTouch;
+	for (unsigned int i = 0; i < m_params.objectCount; ++i)
+	{
+		info.connectedControllers |= ovrControllerType_Object0 << i;
+	}
+	info.sensorCount = c_sensorCount;
+	for (unsigned int i = 0; i < c_sensorCount; ++i)
+	{
+		sensorDesc(info.sensorDesc[i]);
+	}
+	info.outerBoundary.clear();
+	info.playArea.clear();
+	for (int i = 0; i < 4; ++i)
+	{
+		float x = (i == 1 || i == 2) ? 1.0f : -1.0f;
+		float z = (i >= 2) ? 1.0f : -1.0f;
+		ovrVector3f outer = { x * 1.5f, 0, z * 1.5f };
+		ovrVector3f play = { x, 0, z };
+		info.outerBoundary.push_back(outer);
+		info.playArea.push_back(play);
+	}
+	m_infoSent = true;
+	return true;
+}
@@ -0,0 +1,149 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#pragma once
+#include "devicesource.h"
+#include <chrono>
+
+// Small seeded generator (xorshift64*). Used instead of <random> so a seed gives the same
+// data with every compiler and standard library.
+class SyntheticRandom
+{
+public:
+	SyntheticRandom(unsigned long long seed = 1)
+	{
+		setSeed(seed);
+	}
+
+	void setSeed(unsigned long long seed)
+	{
+		// Scramble the seed (splitmix64) so nearby seeds give unrelated sequences. The state must never be 0.
+		seed += 0x9E3779B97F4A7C15ULL;
+		seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+		m_state = (seed ^ (seed >> 31)) | 1;
+	}
+
+	unsigned long long next()
+	{
+		m_state ^= m_state >> 12;
+		m_state ^= m_state << 25;
+		m_state ^= m_state >> 27;
+		return m_state * 0x2545F4914F6CDD1DULL;
+	}
+
+	// [0, 1)
+	double uniform()
+	{
+		return (next() >> 11) * (1.0 / 9007199254740992.0);
+	}
+
+	// Approximately standard normal.
+	double gaussian();
+
+	// Exponential distribution with the given mean, for the gaps between random events.
+	double exponential(double mean);
+
+protected:
+	unsigned long long m_state;
+};
+
+// Randomly occurring periods of some condition, eg. tracking loss or a held button.
+// Events start at a given average rate and last for around the given duration.
+struct SyntheticEvent
+{
+	double rate;		// Events per second, 0 for never
+	double duration;	// Average length of an event in seconds
+	double start;		// Current or next event
+	double end;
+
+	SyntheticEvent() : rate(0), duration(0), start(0), end(0)
+	{
+	}
+
+	void reset(double rateHz, double length, double t, SyntheticRandom &random);
+	// Time must not go backwards between calls.
+	bool active(double t, SyntheticRandom &random);
+};
+
+struct SyntheticParams
+{
+	double rate;					// Samples per second of simulated time
+	double duration;				// Seconds, 0 runs until the sampler is stopped
+	bool realtime;					// Stamp samples with the wall clock and let the sampler pace them
+	unsigned long long seed;
+	float motionScale;				// Multiplier on the size of the motion, 0 for a perfectly still scene
+	unsigned int objectCount;		// Number of VR Objects (0 to 4)
+	bool inputs;					// Generate button, touch, trigger and thumbstick activity
+
+	// IMU-like noise, standard deviations.
+	float positionNoise;			// m
+	float orientationNoise;			// rad
+	float velocityNoise;			// m/s
+	float angularVelocityNoise;		// rad/s
+	float accelerationNoise;		// m/s^2
+
+	// Faults, as events per minute and average length in seconds.
+	float trackingLossRate;			// Per device, position tracking lost and the position held
+	float trackingLossTime;
+	float sensorDropoutRate;		// Per sensor, the sensor disconnects
+	float sensorDropoutTime;
+
+	SyntheticParams() : rate(500.0), duration(0), realtime(true), seed(1), motionScale(1.0f), objectCount(0), inputs(true),
+		positionNoise(0.0002f), orientationNoise(0.0005f), velocityNoise(0.002f), angularVelocityNoise(0.005f), accelerationNoise(0.05f),
+		trackingLossRate(0), trackingLossTime(0.5f), sensorDropoutRate(0), sensorDropoutTime(2.0f)
+	{
+	}
+};
+
+// Generates head, hand, object and sensor data without any hardware.
+// In real time mode it is paced by the sampler and stamped with the wall clock, otherwise it
+// produces samples as fast as they are consumed, on a simulated clock at the given rate.
+// In that mode the output depends only on the params, so a seed always reproduces the same dataset.
+// sample() can also be called directly to generate data without a sampler.
+class SyntheticSource : public DeviceSource
+{
+public:
+	SyntheticSource(const SyntheticParams &params);
+	// A duration of 0 runs until the sampler is stopped.
+	SyntheticSource(double rateHz, double duration, bool realtime);
+
+	const SyntheticParams &params() const;
+
+	virtual void begin();
+	virtual bool sample(VRState &state);
+	virtual bool pollDeviceInfo(DeviceInfo &info, double now);
+	virtual bool paced() const;
+
+protected:
+	enum
+	{
+		c_sensorCount = 2,
+		c_buttonCount = 8
+	};
+
+	void pose(int device, double t, OVR::Vector3f &position, OVR::Quatf &orientation) const;
+	void poseState(int device, double t, ovrPoseStatef &state);
+	unsigned int trackDevice(int device, double t, bool sensorsTracking, ovrPoseStatef &state);
+	void addNoise(ovrPoseStatef &state);
+	void inputs(double t, VRState &state);
+
+	SyntheticParams m_params;
+	unsigned long long m_index;
+	bool m_infoSent;
+	std::chrono::steady_clock::time_point m_start;
+	SyntheticRandom m_random;
+	SyntheticEvent m_trackingLoss[e_deviceCount];
+	ovrPosef m_heldPose[e_deviceCount];				// Last tracked pose, reported while tracking is lost
+	SyntheticEvent m_sensorDropout[c_sensorCount];
+	SyntheticEvent m_buttons[c_buttonCount];
+	// Trajectory at the previous, current and next sample, for differentiating on the simulated clock.
+	OVR::Vector3f m_position[e_deviceCount][3];
+	OVR::Quatf m_orientation[e_deviceCount][3];
+	unsigned long long m_cacheIndex[e_deviceCount];	// Sample the cache is centred on
+};
@@ -0,0 +1,71 @@
+////////////////////////////////////////////////////////////
+// Oculus Monitor
+// Copyright (C) 2018 Kojack (rajetic@gmail.com)
+//
+// KF is released under the MIT License  
+// https://opensource.org/licenses/MIT
+////////////////////////////////////////////////////////////
+
+#pragma once
+
+// Estimates how often a device really delivers new data, from a stream of fresh/repeated samples.
+class UpdateRateEstimator
+{
+public:
+	double m_lastUpdate;	// Runtime time of the last fresh update
+	double m_interval;		// Smoothed interval between fresh updates
+	double m_maxGap;		// Longest interval seen since reset
+	unsigned int m_updates;
+	unsigned int m_repeats;
+	unsigned int m_gaps;	// Intervals much longer than the smoothed interval
+
+	UpdateRateEstimator()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		m_lastUpdate = 0;
+		m_interval = 0;
+		m_maxGap = 0;
+		m_updates = 0;
+		m_repeats = 0;
+		m_gaps = 0;
+	}
+
+	void update(bool fresh, double time)
+	{
+		if (!fresh)
+		{
+			m_repeats++;
+			return;
+		}
+		if (m_updates > 0)
+		{
+			double interval = time - m_lastUpdate;
+			if (m_updates > 8 && interval > m_interval * 2.5)
+			{
+				m_gaps++;
+			}
+			if (interval > m_maxGap)
+			{
+				m_maxGap = interval;
+			}
+			m_interval = m_updates == 1 ? interval : m_interval * 0.95 + interval * 0.05;
+		}
+		m_lastUpdate = time;
+		m_updates++;
+	}
+
+	double rate() const
+	{
+		return m_interval > 0 ? 1.0 / m_interval : 0.0;
+	}
+
+	// Time since the last fresh update.
+	double age(double now) const
+	{
+		return m_updates > 0 ? now - m_lastUpdate : 0.0;
+	}
+};
@@ -7,64 +7,119 @@
 ////////////////////////////////////////////////////////////
 
 #include "vrstate.h"
+#include "sampler.h"
+#include "flightrecorder.h"
 #include <fstream>
 #include <string>
+#include <iomanip>
+#include <cstring>
+#include <algorithm>
 
-StateManager::StateManager() : m_pollState(e_live), m_current(0)
+const char *g_trackedDeviceNames[e_deviceCount] = { "Head", "Left Touch", "Right Touch", "Object 0", "Object 1", "Object 2", "Object 3" };
+
+const ovrPoseStatef &devicePose(const VRState &state, int device)
 {
-	m_samples.resize(216000);
+	switch (device)
+	{
+	case e_deviceHead:
+		return state.trackingState.HeadPose;
+	case e_deviceLeftTouch:
+		return state.trackingState.HandPoses[0];
+	case e_deviceRightTouch:
+		return state.trackingState.HandPoses[1];
+	default:
+		return state.objectPoses[device - e_deviceObject0];
+	}
 }
 
-VRState StateManager::poll(ovrSession hmd, double time)
+bool deviceActive(const VRState &state, int device)
 {
-	VRState state;
-	if (m_pollState != e_playback)
-	{
-		state.trackingState = ovr_GetTrackingState(hmd, 0, false);
-		ovrInputState temp;
-		ovr_GetInputState(hmd, ovrControllerType::ovrControllerType_Remote, &temp);
-		state.remoteButtons = temp.Buttons;
-		ovr_GetInputState(hmd, ovrControllerType::ovrControllerType_Touch, &temp);
-		state.touchButtons = temp.Buttons;
-		state.touchTouch = temp.Touches;
-		for (int i = 0; i < 2; ++i)
+	switch (device)
+	{
+	case e_deviceHead:
+		return true;
+	case e_deviceLeftTouch:
+		return state.trackingState.HandStatusFlags[0] != 0;
+	case e_deviceRightTouch:
+		return state.trackingState.HandStatusFlags[1] != 0;
+	default:
+		return (state.objectFlags & (1 << (device - e_deviceObject0))) != 0;
+	}
+}
+
+int findEpoch(const std::vector<DeviceEpoch> &epochs, unsigned int sample)
+{
+	std::vector<DeviceEpoch>::const_iterator it = std::upper_bound(epochs.begin(), epochs.end(), sample, [](unsigned int i, const DeviceEpoch &epoch) { return i < epoch.start; });
+	return (int)(it - epochs.begin()) - 1;
+}
+
+StateManager::StateManager() : m_flightRecorder(0), m_pollState(e_live), m_current(0), m_live(), m_recordStarted(false), m_recordTime(0), m_lastRuntimeTime(0), m_lastRecorded(), m_repeatsSkipped(0)
+{
+}
+
+VRState StateManager::poll(Sampler &sampler, double time, bool paused)
+{
+	VRState sample;
+	while (sampler.pop(sample))
+	{
+		m_jitter.update(sample.wallTime, sample.runtimeTime, sample.sampleRate, sample.lateness);
+		for (int i = 0; i < e_deviceCount; ++i)
+		{
+			if (deviceActive(sample, i))
+			{
+				m_deviceRates[i].update((sample.freshFlags & (1 << i)) != 0, devicePose(sample, i).TimeInSeconds);
+			}
+		}
+		if (m_pollState == e_record || m_flightRecorder)
+		{
+			if (!m_epochInfo || m_epochInfo->version != sample.epoch)
+			{
+				std::shared_ptr<const DeviceInfo> info = sampler.epoch(sample.epoch);
+				if (info)
+				{
+					m_epochInfo = info;
+				}
+			}
+		}
+		if (m_flightRecorder)
 		{
-			state.touchHandTrigger[i] = temp.HandTrigger[i];
-			state.touchHandTriggerNDZ[i] = temp.HandTriggerNoDeadzone[i];
-			state.touchHandTriggerRaw[i] = temp.HandTriggerRaw[i];
-			state.touchIndexTrigger[i] = temp.IndexTrigger[i];
-			state.touchIndexTriggerNDZ[i] = temp.IndexTriggerNoDeadzone[i];
-			state.touchIndexTriggerRaw[i] = temp.IndexTriggerRaw[i];
-			state.touchThumbStick[i] = temp.Thumbstick[i];
-			state.touchThumbStickNDZ[i] = temp.ThumbstickNoDeadzone[i];
-			state.touchThumbStickRaw[i] = temp.ThumbstickRaw[i];
+			m_flightRecorder->add(sample, m_epochInfo);
 		}
-		state.sensorCount = ovr_GetTrackerCount(hmd);
-		for (unsigned int i = 0; i < state.sensorCount; ++i)
+		if (m_pollState == e_record)
 		{
-			state.sensorDesc[i] = ovr_GetTrackerDesc(hmd, i);
-			state.sensorPose[i] = ovr_GetTrackerPose(hmd, i);
+			record(sample, paused);
 		}
-		state.time = time;
+		m_live = sample;
 	}
-	else
+
+	VRState state = m_live;
+	if (m_pollState == e_playback && m_samples.size() < 2)
 	{
+		if (!m_samples.empty())
+		{
+			m_samples.get(0, state);
+		}
+	}
+	else if (m_pollState == e_playback)
+	{
+		// The timeline starts at the first sample (a flight recorder snapshot doesn't start at 0).
+		time += m_samples.time(0);
+		// Seek using only the time column, then gather the one sample that is shown.
+		int previous = m_current;
 		while (true)
 		{
-			if (m_samples[m_current].time <= time)
+			if (m_samples.time(m_current) <= time)
 			{
-				if (m_samples[m_current + 1].time > time)
+				if (m_samples.time(m_current + 1) > time)
 				{
-					state = m_samples[m_current];
 					break;
 				}
 				else
 				{
 					m_current++;
-					if (m_current > m_samples.size() - 2)
+					if (m_current > (int)m_samples.size() - 2)
 					{
-						m_current = m_samples.size() - 2;
-						state = m_samples[m_current];
+						m_current = (int)m_samples.size() - 2;
 						break;
 					}
 				}
@@ -75,75 +130,216 @@ VRState StateManager::poll(ovrSession hmd, double time)
 				if (m_current < 0)
 				{
 					m_current = 0;
-					state = m_samples[m_current];
 					break;
 				}
 			}
 		}
+		if (m_current != previous)
+		{
+			m_samples.readAhead(m_current, m_current > previous ? 1 : -1);
+		}
+		m_samples.get(m_current, state);
 	}
 
-	if (m_pollState == e_record)
+	return state;
+}
+
+void StateManager::record(VRState state, bool paused)
+{
+	// Samples are stamped with the runtime clock. The recording timeline only advances while not paused.
+	if (m_recordStarted && !paused)
+	{
+		m_recordTime += state.runtimeTime - m_lastRuntimeTime;
+	}
+	m_lastRuntimeTime = state.runtimeTime;
+	m_recordStarted = true;
+	if (paused)
 	{
-		m_samples.push_back(state);
+		return;
 	}
+	state.time = m_recordTime;
+	// Polling faster than the devices update gives runs of identical samples. Only keep the first,
+	// playback holds it until the next genuinely new sample.
+	if (!m_samples.empty() && isRepeat(m_lastRecorded, state))
+	{
+		m_repeatsSkipped++;
+		return;
+	}
+	m_lastRecorded = state;
+	if (m_rateSegments.empty() || m_rateSegments.back().rate != state.sampleRate)
+	{
+		RateSegment segment = { (unsigned int)m_samples.size(), state.sampleRate };
+		m_rateSegments.push_back(segment);
+	}
+	if (m_epochInfo && (m_epochs.empty() || m_epochs.back().info != m_epochInfo))
+	{
+		DeviceEpoch epoch = { (unsigned int)m_samples.size(), m_epochInfo };
+		m_epochs.push_back(epoch);
+	}
+	m_samples.push_back(state);
+}
 
-	return state;
+bool StateManager::isRepeat(const VRState &a, const VRState &b)
+{
+	if (b.freshFlags != 0 || a.epoch != b.epoch)
+		return false;
+	if (a.remoteButtons != b.remoteButtons || a.touchButtons != b.touchButtons || a.touchTouch != b.touchTouch)
+		return false;
+	if (memcmp(a.touchThumbStick, b.touchThumbStick, (const char *)&b.trackingState - (const char *)b.touchThumbStick) != 0)
+		return false;
+	if (a.trackingState.StatusFlags != b.trackingState.StatusFlags || a.trackingState.HandStatusFlags[0] != b.trackingState.HandStatusFlags[0] || a.trackingState.HandStatusFlags[1] != b.trackingState.HandStatusFlags[1])
+		return false;
+	if (memcmp(&a.trackingState.CalibratedOrigin, &b.trackingState.CalibratedOrigin, sizeof(ovrPosef)) != 0)
+		return false;
+	if (a.objectFlags != b.objectFlags || a.sensorCount != b.sensorCount || memcmp(a.sensorPose, b.sensorPose, sizeof(a.sensorPose)) != 0)
+		return false;
+	return true;
+}
+
+float StateManager::sampleRate(unsigned int index) const
+{
+	// Find the last segment starting at or before index.
+	std::vector<RateSegment>::const_iterator it = std::upper_bound(m_rateSegments.begin(), m_rateSegments.end(), index, [](unsigned int i, const RateSegment &segment) { return i < segment.start; });
+	if (it == m_rateSegments.begin())
+	{
+		return 0;
+	}
+	return (it - 1)->rate;
+}
+
+const DeviceInfo &StateManager::epoch(unsigned int index) const
+{
+	static const DeviceInfo s_none;
+	int i = findEpoch(m_epochs, index);
+	return i < 0 ? s_none : *m_epochs[i].info;
 }
 
 void StateManager::reset()
 {
 	m_samples.clear();
+	m_rateSegments.clear();
+	m_epochs.clear();
+	m_repeatsSkipped = 0;
 	m_current = 0;
 	m_pollState = e_live;
+	m_recordStarted = false;
+	m_recordTime = 0;
 }
 
-void StateManager::exportCSV(const std::string &filename)
+void StateManager::writeCSVHeader(std::ostream &out)
+{
+	out << "Time,RuntimeTime,SampleRate,Lateness,HeadPoseTime,LeftTouchPoseTime,RightTouchPoseTime,";
+	for (int i = 0; i < e_latencyCount; ++i)
+	{
+		out << g_latencyColumnNames[i] << ",";
+	}
+	out << "RemoteButtons,TouchButtons,TouchTouches,LeftIndexTrigger,RightIndexTrigger,LeftHandTrigger,RightHandTrigger,LeftTouchPosX,LeftTouchPosY,LeftTouchPosZ,LeftTouchOrientationW,LeftTouchOrientationX,LeftTouchOrientationY,LeftTouchOrientationZ,RightTouchPosX,RightTouchPosY,RightTouchPosZ,RightTouchOrientationW,RightTouchOrientationX,RightTouchOrientationY,RightTouchOrientationZ,HeadPosX,HeadPosY,HeadPosZ,HeadOrientationW,HeadOrientationX,HeadOrientationY,HeadOrientationZ,Object0PosX,Object0PosY,Object0PosZ,Object0OrientationW,Object0OrientationX,Object0OrientationY,Object0OrientationZ,Object1PosX,Object1PosY,Object1PosZ,Object1OrientationW,Object1OrientationX,Object1OrientationY,Object1OrientationZ,Object2PosX,Object2PosY,Object2PosZ,Object2OrientationW,Object2OrientationX,Object2OrientationY,Object2OrientationZ,Object3PosX,Object3PosY,Object3PosZ,Object3OrientationW,Object3OrientationX,Object3OrientationY,Object3OrientationZ,Sensor0PosX, Sensor0PosY, Sensor0PosZ, Sensor0OrientationW, Sensor0OrientationX, Sensor0OrientationY, Sensor0OrientationZ,Sensor1PosX, Sensor1PosY, Sensor1PosZ, Sensor1OrientationW, Sensor1OrientationX, Sensor1OrientationY, Sensor1OrientationZ,Sensor2PosX, Sensor2PosY, Sensor2PosZ, Sensor2OrientationW, Sensor2OrientationX, Sensor2OrientationY, Sensor2OrientationZ,Sensor3PosX, Sensor3PosY, Sensor3PosZ, Sensor3OrientationW, Sensor3OrientationX, Sensor3OrientationY, Sensor3OrientationZ" << std::endl;
+}
+
+void StateManager::writeCSVRow(std::ostream &out, const VRState &s, float sampleRate)
+{
+	out << s.time << ",";
+	out << s.runtimeTime << ",";
+	out << sampleRate << ",";
+	out << s.lateness << ",";
+	out << s.trackingState.HeadPose.TimeInSeconds << ",";
+	out << s.trackingState.HandPoses[0].TimeInSeconds << ",";
+	out << s.trackingState.HandPoses[1].TimeInSeconds << ",";
+	for (int i = 0; i < e_latencyCount; ++i)
+	{
+		out << s.latency[i] << ",";
+	}
+	out << s.remoteButtons << ",";
+	out << s.touchButtons << ",";
+	out << s.touchTouch << ",";
+	out << s.touchIndexTrigger[0] << ",";
+	out << s.touchIndexTrigger[1] << ",";
+	out << s.touchHandTrigger[0] << ",";
+	out << s.touchHandTrigger[1] << ",";
+	out << s.trackingState.HandPoses[0].ThePose.Position.x << ",";
+	out << s.trackingState.HandPoses[0].ThePose.Position.y << ",";
+	out << s.trackingState.HandPoses[0].ThePose.Position.z << ",";
+	out << s.trackingState.HandPoses[0].ThePose.Orientation.w << ",";
+	out << s.trackingState.HandPoses[0].ThePose.Orientation.x << ",";
+	out << s.trackingState.HandPoses[0].ThePose.Orientation.y << ",";
+	out << s.trackingState.HandPoses[0].ThePose.Orientation.z << ",";
+	out << s.trackingState.HandPoses[1].ThePose.Position.x << ",";
+	out << s.trackingState.HandPoses[1].ThePose.Position.y << ",";
+	out << s.trackingState.HandPoses[1].ThePose.Position.z << ",";
+	out << s.trackingState.HandPoses[1].ThePose.Orientation.w << ",";
+	out << s.trackingState.HandPoses[1].ThePose.Orientation.x << ",";
+	out << s.trackingState.HandPoses[1].ThePose.Orientation.y << ",";
+	out << s.trackingState.HandPoses[1].ThePose.Orientation.z << ",";
+	out << s.trackingState.HeadPose.ThePose.Position.x << ",";
+	out << s.trackingState.HeadPose.ThePose.Position.y << ",";
+	out << s.trackingState.HeadPose.ThePose.Position.z << ",";
+	out << s.trackingState.HeadPose.ThePose.Orientation.w << ",";
+	out << s.trackingState.HeadPose.ThePose.Orientation.x << ",";
+	out << s.trackingState.HeadPose.ThePose.Orientation.y << ",";
+	out << s.trackingState.HeadPose.ThePose.Orientation.z << ",";
+	for (int j = 0; j < 4; ++j)
+	{
+		out << s.objectPoses[j].ThePose.Position.x << ",";
+		out << s.objectPoses[j].ThePose.Position.y << ",";
+		out << s.objectPoses[j].ThePose.Position.z << ",";
+		out << s.objectPoses[j].ThePose.Orientation.w << ",";
+		out << s.objectPoses[j].ThePose.Orientation.x << ",";
+		out << s.objectPoses[j].ThePose.Orientation.y << ",";
+		out << s.objectPoses[j].ThePose.Orientation.z << ",";
+	}
+	for (int j = 0; j < s.sensorCount; ++j)
+	{
+		out << s.sensorPose[j].Pose.Position.x << ",";
+		out << s.sensorPose[j].Pose.Position.y << ",";
+		out << s.sensorPose[j].Pose.Position.z << ",";
+		out << s.sensorPose[j].Pose.Orientation.w << ",";
+		out << s.sensorPose[j].Pose.Orientation.x << ",";
+		out << s.sensorPose[j].Pose.Orientation.y << ",";
+		out << s.sensorPose[j].Pose.Orientation.z << ",";
+	}
+	out << "\n";
+}
+
+void StateManager::exportCSV(const std::string &filename, unsigned int heldButton)
 {
 	std::fstream out(filename, std::ios::out);
-	out << "Time,RemoteButtons,TouchButtons,TouchTouches,LeftIndexTrigger,RightIndexTrigger,LeftHandTrigger,RightHandTrigger,LeftTouchPosX,LeftTouchPosY,LeftTouchPosZ,LeftTouchOrientationW,LeftTouchOrientationX,LeftTouchOrientationY,LeftTouchOrientationZ,RightTouchPosX,RightTouchPosY,RightTouchPosZ,RightTouchOrientationW,RightTouchOrientationX,RightTouchOrientationY,RightTouchOrientationZ,HeadPosX,HeadPosY,HeadPosZ,HeadOrientationW,HeadOrientationX,HeadOrientationY,HeadOrientationZ,Sensor0PosX, Sensor0PosY, Sensor0PosZ, Sensor0OrientationW, Sensor0OrientationX, Sensor0OrientationY, Sensor0OrientationZ,Sensor1PosX, Sensor1PosY, Sensor1PosZ, Sensor1OrientationW, Sensor1OrientationX, Sensor1OrientationY, Sensor1OrientationZ,Sensor2PosX, Sensor2PosY, Sensor2PosZ, Sensor2OrientationW, Sensor2OrientationX, Sensor2OrientationY, Sensor2OrientationZ,Sensor3PosX, Sensor3PosY, Sensor3PosZ, Sensor3OrientationW, Sensor3OrientationX, Sensor3OrientationY, Sensor3OrientationZ" << std::endl;
-	for (int i = 0; i < m_samples.size(); ++i)
-	{
-		VRState &s = m_samples[i];
-		out << s.time << ",";
-		out << s.remoteButtons << ",";
-		out << s.touchButtons << ",";
-		out << s.touchTouch << ",";
-		out << s.touchIndexTrigger[0] << ",";
-		out << s.touchIndexTrigger[1] << ",";
-		out << s.touchHandTrigger[0] << ",";
-		out << s.touchHandTrigger[1] << ",";
-		out << s.trackingState.HandPoses[0].ThePose.Position.x << ",";
-		out << s.trackingState.HandPoses[0].ThePose.Position.y << ",";
-		out << s.trackingState.HandPoses[0].ThePose.Position.z << ",";
-		out << s.trackingState.HandPoses[0].ThePose.Orientation.w << ",";
-		out << s.trackingState.HandPoses[0].ThePose.Orientation.x << ",";
-		out << s.trackingState.HandPoses[0].ThePose.Orientation.y << ",";
-		out << s.trackingState.HandPoses[0].ThePose.Orientation.z << ",";
-		out << s.trackingState.HandPoses[1].ThePose.Position.x << ",";
-		out << s.trackingState.HandPoses[1].ThePose.Position.y << ",";
-		out << s.trackingState.HandPoses[1].ThePose.Position.z << ",";
-		out << s.trackingState.HandPoses[1].ThePose.Orientation.w << ",";
-		out << s.trackingState.HandPoses[1].ThePose.Orientation.x << ",";
-		out << s.trackingState.HandPoses[1].ThePose.Orientation.y << ",";
-		out << s.trackingState.HandPoses[1].ThePose.Orientation.z << ",";
-		out << s.trackingState.HeadPose.ThePose.Position.x << ",";
-		out << s.trackingState.HeadPose.ThePose.Position.y << ",";
-		out << s.trackingState.HeadPose.ThePose.Position.z << ",";
-		out << s.trackingState.HeadPose.ThePose.Orientation.w << ",";
-		out << s.trackingState.HeadPose.ThePose.Orientation.x << ",";
-		out << s.trackingState.HeadPose.ThePose.Orientation.y << ",";
-		out << s.trackingState.HeadPose.ThePose.Orientation.z << ",";
-		for (int j = 0; j < s.sensorCount; ++j)
+	out << std::setprecision(15);
+	writeCSVHeader(out);
+
+	// Velocities, accelerations and the raw/NDZ inputs aren't exported, so don't gather them.
+	std::vector<int> columns = { e_columnTime, e_columnRuntimeTime, e_columnLateness, e_columnLatency, e_columnIndexTrigger, e_columnHandTrigger,
+		e_columnSensorCount, e_columnSensorPose };
+	for (int i = 0; i < e_deviceCount; ++i)
+	{
+		columns.push_back(SampleStore::poseColumn(i, e_posePosition));
+		columns.push_back(SampleStore::poseColumn(i, e_poseOrientation));
+	}
+	for (int i = e_deviceHead; i <= e_deviceRightTouch; ++i)
+	{
+		columns.push_back(SampleStore::poseColumn(i, e_poseTime));
+	}
+	VRState state;
+	memset(&state, 0, sizeof(state));
+	double start = m_samples.empty() ? 0 : m_samples.time(0);
+	std::vector<ButtonPress> ranges;
+	if (heldButton)
+	{
+		m_samples.presses(e_buttonTouch, heldButton, ranges);
+	}
+	else if (!m_samples.empty())
+	{
+		ButtonPress all = { 0, m_samples.size(), 0 };
+		ranges.push_back(all);
+	}
+	for (size_t r = 0; r < ranges.size(); ++r)
+	{
+		for (unsigned int i = ranges[r].start; i < ranges[r].end; ++i)
 		{
-			out << s.sensorPose[j].Pose.Position.x << ",";
-			out << s.sensorPose[j].Pose.Position.y << ",";
-			out << s.sensorPose[j].Pose.Position.z << ",";
-			out << s.sensorPose[j].Pose.Orientation.w << ",";
-			out << s.sensorPose[j].Pose.Orientation.x << ",";
-			out << s.sensorPose[j].Pose.Orientation.y << ",";
-			out << s.sensorPose[j].Pose.Orientation.z << ",";
+			m_samples.readAhead(i, 1);
+			m_samples.get(i, state, columns);
+			state.time -= start;
+			writeCSVRow(out, state, sampleRate(i));
 		}
-		out << std::endl;
 	}
 }
 
@@ -481,14 +677,39 @@ void StateManager::writeDAEOrientation(std::fstream &out, std::vector<Keyframe>
 	out << "	</animation>" << std::endl;
 }
 
-void StateManager::exportDAE(ovrSession hmd, const std::string &filename)
+void StateManager::readDAEFrames(std::vector<Keyframe> &frames, int device)
+{
+	for (unsigned int b = 0; b < m_samples.blockCount(); ++b)
+	{
+		m_samples.readAhead(b << SampleStore::c_blockShift, 1);
+		const ovrVector3f *position = m_samples.column<ovrVector3f>(b, SampleStore::poseColumn(device, e_posePosition));
+		const ovrQuatf *orientation = m_samples.column<ovrQuatf>(b, SampleStore::poseColumn(device, e_poseOrientation));
+		Keyframe *frame = &frames[b << SampleStore::c_blockShift];
+		for (unsigned int i = 0; i < m_samples.blockSize(b); ++i)
+		{
+			frame[i].position = position[i];
+			frame[i].orientation = orientation[i];
+		}
+	}
+}
+
+void StateManager::exportDAE(const std::string &filename)
 {
 	std::fstream out(filename, std::ios::out);
+	out << std::setprecision(10);
 	int sensorMaxCount = 0;
-	for (int i = 0; i < m_samples.size(); ++i)
+	unsigned int objectFlags = 0;
+	for (unsigned int b = 0; b < m_samples.blockCount(); ++b)
 	{
-		if (m_samples[i].sensorCount > sensorMaxCount)
-			sensorMaxCount = m_samples[i].sensorCount;
+		m_samples.readAhead(b << SampleStore::c_blockShift, 1);
+		const unsigned int *sensorCount = m_samples.column<unsigned int>(b, e_columnSensorCount);
+		const unsigned int *flags = m_samples.column<unsigned int>(b, e_columnObjectFlags);
+		for (unsigned int i = 0; i < m_samples.blockSize(b); ++i)
+		{
+			if (sensorCount[i] > sensorMaxCount)
+				sensorMaxCount = sensorCount[i];
+			objectFlags |= flags[i];
+		}
 	}
 
 	out << "<?xml version=\"1.0\" encoding=\"utf-8\"?>" << std::endl;
@@ -499,53 +720,60 @@ void StateManager::exportDAE(ovrSession hmd, const std::string &filename)
 	out << "</asset>" << std::endl;
 
 
+	const DeviceInfo &info = epoch(0);
 	out << "	<library_cameras>" << std::endl;
 	for (int i = 0; i < sensorMaxCount; ++i)
 	{
-		ovrTrackerDesc &desc = m_samples.front().sensorDesc[i];
+		const ovrTrackerDesc &desc = info.sensorDesc[i];
 		writeDAECamera(out, "Sensor" + std::to_string(i) + "-camera", desc.FrustumHFovInRadians, desc.FrustumVFovInRadians, desc.FrustumNearZInMeters, desc.FrustumFarZInMeters);
 	}
 
-	ovrHmdDesc hd = ovr_GetHmdDesc(hmd);
+	const ovrHmdDesc &hd = info.hmdDesc;
 	writeDAECamera(out, "Head-camera", atan(hd.MaxEyeFov[0].LeftTan) * (180.0 / 3.14159265), atan(hd.MaxEyeFov[0].UpTan) * (180.0 / 3.14159265), 0.01, 100);
 	out << "	</library_cameras>" << std::endl;
 
 	out << "<library_animations>" << std::endl;
 	std::vector<Keyframe> frames(m_samples.size());
-	for (int i = 0; i < m_samples.size(); ++i)
+	for (unsigned int i = 0; i < m_samples.size(); ++i)
 	{
-		frames[i].time = m_samples[i].time;
-		frames[i].position = m_samples[i].trackingState.HandPoses[0].ThePose.Position;
-		frames[i].orientation = m_samples[i].trackingState.HandPoses[0].ThePose.Orientation;
+		frames[i].time = m_samples.time(i) - m_samples.time(0);
 	}
+	readDAEFrames(frames, e_deviceLeftTouch);
 	writeDAEPositions(out, frames, "Left");
 	writeDAEOrientation(out, frames, "Left");
-	for (int i = 0; i < m_samples.size(); ++i)
-	{
-		frames[i].position = m_samples[i].trackingState.HandPoses[1].ThePose.Position;
-		frames[i].orientation = m_samples[i].trackingState.HandPoses[1].ThePose.Orientation;
-	}
+	readDAEFrames(frames, e_deviceRightTouch);
 	writeDAEPositions(out, frames, "Right");
 	writeDAEOrientation(out, frames, "Right");
-	for (int i = 0; i < m_samples.size(); ++i)
-	{
-		frames[i].position = m_samples[i].trackingState.HeadPose.ThePose.Position;
-		frames[i].orientation = m_samples[i].trackingState.HeadPose.ThePose.Orientation;
-	}
+	readDAEFrames(frames, e_deviceHead);
 	writeDAEPositions(out, frames, "Head");
 	writeDAEOrientation(out, frames, "Head");
 
 	for (int s = 0; s < sensorMaxCount; ++s)
 	{
-		for (int i = 0; i < m_samples.size(); ++i)
+		for (unsigned int b = 0; b < m_samples.blockCount(); ++b)
 		{
-			frames[i].position = m_samples[i].sensorPose[s].Pose.Position;
-			frames[i].orientation = m_samples[i].sensorPose[s].Pose.Orientation;
+			m_samples.readAhead(b << SampleStore::c_blockShift, 1);
+			const ovrTrackerPose (*sensors)[4] = m_samples.column<ovrTrackerPose[4]>(b, e_columnSensorPose);
+			Keyframe *frame = &frames[b << SampleStore::c_blockShift];
+			for (unsigned int i = 0; i < m_samples.blockSize(b); ++i)
+			{
+				frame[i].position = sensors[i][s].Pose.Position;
+				frame[i].orientation = sensors[i][s].Pose.Orientation;
+			}
 		}
 		writeDAEPositions(out, frames, "Sensor" + std::to_string(s));
 		writeDAEOrientation(out, frames, "Sensor" + std::to_string(s));
 	}
 
+	for (int o = 0; o < 4; ++o)
+	{
+		if (!(objectFlags & (1 << o)))
+			continue;
+		readDAEFrames(frames, e_deviceObject0 + o);
+		writeDAEPositions(out, frames, "Object" + std::to_string(o));
+		writeDAEOrientation(out, frames, "Object" + std::to_string(o));
+	}
+
 	out << "</library_animations>" << std::endl;
 	out << "<library_visual_scenes>" << std::endl;
 	out << "	<visual_scene id=\"Scene\" name=\"Scene\">" << std::endl;
@@ -591,6 +819,20 @@ void StateManager::exportDAE(ovrSession hmd, const std::string &filename)
 		out << "      </node>" << std::endl;
 	}
 
+	for (int i = 0; i < 4; ++i)
+	{
+		if (!(objectFlags & (1 << i)))
+			continue;
+		std::string name = "Object" + std::to_string(i);
+		out << "      <node id=\"" << name << "\" name=\"" << name << "\" type=\"NODE\">" << std::endl;
+		out << "        <translate sid=\"location\">0 0 0</translate>" << std::endl;
+		out << "        <rotate sid=\"rotationZ\">0 0 1 0</rotate>" << std::endl;
+		out << "        <rotate sid=\"rotationY\">0 1 0 0</rotate>" << std::endl;
+		out << "        <rotate sid=\"rotationX\">1 0 0 0</rotate>" << std::endl;
+		out << "        <scale sid=\"scale\">1 1 1</scale>" << std::endl;
+		out << "      </node>" << std::endl;
+	}
+
 	out << "    </visual_scene>" << std::endl;
 	out << "  </library_visual_scenes>" << std::endl;
 	out << "  <scene>" << std::endl;
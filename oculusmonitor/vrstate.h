@@ -9,11 +9,36 @@
 #pragma once
 #include "OVR_CAPI.h"
 #include "Extras/OVR_Math.h"
+#include "updaterate.h"
+#include "latency.h"
+#include "jitter.h"
 #include <vector>
+#include <memory>
+#include <iosfwd>
+
+// Devices with a pose in VRState.
+enum TrackedDevice
+{
+	e_deviceHead,
+	e_deviceLeftTouch,
+	e_deviceRightTouch,
+	e_deviceObject0,
+	e_deviceObject1,
+	e_deviceObject2,
+	e_deviceObject3,
+	e_deviceCount
+};
+
+extern const char *g_trackedDeviceNames[e_deviceCount];
 
 struct VRState
 {
-	float time;
+	double time;			// Seconds on the recording timeline (or runtime clock for live samples)
+	double runtimeTime;		// ovr_GetTimeInSeconds() when the sample was taken
+	double wallTime;		// Sampler clock (seconds since the sampler started) when the sample was taken
+	float lateness;			// Microseconds after its scheduled time the sample was taken
+	float sampleRate;		// Sampler rate in effect when the sample was taken
+	unsigned int epoch;		// DeviceInfo::version in effect when the sample was taken
 	unsigned int remoteButtons;
 	unsigned int touchButtons;
 	unsigned int touchTouch;
@@ -27,11 +52,59 @@ struct VRState
 	float touchIndexTriggerNDZ[2];
 	float touchIndexTriggerRaw[2];
 	ovrTrackingState trackingState;
+	unsigned int objectFlags;		// Bit n set if VR Object n was connected
+	ovrPoseStatef objectPoses[4];
+	unsigned int freshFlags;		// Bit n set if TrackedDevice n delivered a new pose since the previous sample
 	unsigned int sensorCount;
 	ovrTrackerPose sensorPose[4];
+	float latency[e_latencyCount];	// Microseconds spent in each LatencyCall while taking this sample, 0 if not called
+};
+
+// Needs VRState.
+#include "samplestore.h"
+
+class Sampler;
+class FlightRecorder;
+
+// Slowly changing device data. Polled at a low rate by the sampler rather than every sample.
+struct DeviceInfo
+{
+	unsigned int version;	// Incremented whenever anything below changes
+	ovrHmdDesc hmdDesc;
+	ovrTrackingOrigin trackingOrigin;
+	unsigned int connectedControllers;
+	unsigned int sensorCount;
 	ovrTrackerDesc sensorDesc[4];
+	std::vector<ovrVector3f> outerBoundary;
+	std::vector<ovrVector3f> playArea;
+
+	DeviceInfo() : version(0), hmdDesc(), trackingOrigin(ovrTrackingOrigin_EyeLevel), connectedControllers(0), sensorCount(0), sensorDesc()
+	{
+	}
+};
+
+// A run of recorded samples taken under the same DeviceInfo. Samples only carry the version, the
+// descriptors, boundary and tracking origin are stored once per epoch.
+struct DeviceEpoch
+{
+	unsigned int start;		// Index of the first sample in the epoch
+	std::shared_ptr<const DeviceInfo> info;
 };
 
+// Index of the epoch holding the given sample, -1 if none.
+int findEpoch(const std::vector<DeviceEpoch> &epochs, unsigned int sample);
+
+// A run of recorded samples taken at the same sampler rate.
+struct RateSegment
+{
+	unsigned int start;		// Index of the first sample in the segment
+	float rate;
+};
+
+const ovrPoseStatef &devicePose(const VRState &state, int device);
+// True if the device is connected and (for hands) tracked in this sample.
+bool deviceActive(const VRState &state, int device);
+
 struct Keyframe
 {
 	double time;
@@ -49,18 +122,42 @@ public:
 		e_record
 	};
 
-	std::vector<VRState> m_samples;
+	SampleStore m_samples;		// Times start wherever the recording started, the timeline starts at the first sample
+	std::vector<RateSegment> m_rateSegments;
+	std::vector<DeviceEpoch> m_epochs;
+	std::shared_ptr<const DeviceInfo> m_epochInfo;	// Info for the samples being recorded
+	FlightRecorder *m_flightRecorder;				// Fed every sample if set
 	double m_time;
 	PollState m_pollState;
 	int m_current;
+	VRState m_live;
+	bool m_recordStarted;
+	double m_recordTime;
+	double m_lastRuntimeTime;
+	VRState m_lastRecorded;
+	unsigned int m_repeatsSkipped;
+	UpdateRateEstimator m_deviceRates[e_deviceCount];
+	JitterMonitor m_jitter;
 
 	StateManager();
-	VRState poll(ovrSession hmd, double time);
+	// Drain the sampler, recording if needed, and return the live or playback state for the UI.
+	VRState poll(Sampler &sampler, double time, bool paused);
+	void record(VRState state, bool paused);
+	// True if b holds nothing new compared to a: no fresh poses and identical inputs, status and sensors.
+	static bool isRepeat(const VRState &a, const VRState &b);
 	void reset();
+	// Sampler rate the given recorded sample was taken at.
+	float sampleRate(unsigned int index) const;
+	// Device info the given recorded sample was taken under.
+	const DeviceInfo &epoch(unsigned int index) const;
 	void writeDAECamera(std::fstream &out, std::string name, float hfov, float vfov, float near, float far);
+	void readDAEFrames(std::vector<Keyframe> &frames, int device);
 	void writeDAEPositions(std::fstream &out, std::vector<Keyframe> &keys, std::string name);
 	void writeDAEOrientation(std::fstream &out, std::vector<Keyframe> &keys, std::string name);
-	void exportCSV(const std::string &filename);
-	void exportDAE(ovrSession hmd, const std::string &filename);
+	static void writeCSVHeader(std::ostream &out);
+	static void writeCSVRow(std::ostream &out, const VRState &s, float sampleRate);
+	// With heldButton (an ovrButton) set, only the samples while it was held are exported.
+	void exportCSV(const std::string &filename, unsigned int heldButton = 0);
+	void exportDAE(const std::string &filename);
 
 };